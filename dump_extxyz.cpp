@@ -15,17 +15,161 @@
 #include "dump_extxyz.h"
 
 #include "atom.h"
+#include "comm.h"
 #include "error.h"
+#include "extxyz_counters.h"
+#include "extxyz_index.h"
+#include "extxyz_sink.h"
+#include "extxyz_sink_adios2.h"
+#include "extxyz_sink_arrow.h"
+#include "extxyz_sink_h5md.h"
+#include "extxyz_stage.h"
+#include "extxyz_trace.h"
+#include "extxyz_writer.h"
+#include "fix_store.h"
+#include "group.h"
 #include "memory.h"
+#include "modify.h"
+#include "output.h"
+#include "platform.h"
 #include "update.h"
 #include "domain.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
 #include <cstring>
+#include <limits>
+#include <random>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef LAMMPS_ZSTD
+#include <zstd.h>
+#endif
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
 
 using namespace LAMMPS_NS;
 
-#define ONELINE 128
 #define DELTA 1048576
+#define NWINDOW 4
+#define COARSEDIGITS 5
+#define CHECKBLOCK 1024
+
+enum { ASCEND, DESCEND };    // values of Dump::sortorder
+
+/* ----------------------------------------------------------------------
+   digits of the floating-point conversions of a compiled format
+   fmt produces the same correctly rounded digits as printf
+------------------------------------------------------------------------- */
+
+template <char CONV> static char *float_digits(char *, double, int);
+
+template <> char *float_digits<'f'>(char *p, double v, int prec)
+{
+  return fmt::format_to(p, "{:.{}f}", v, prec);
+}
+
+template <> char *float_digits<'e'>(char *p, double v, int prec)
+{
+  return fmt::format_to(p, "{:.{}e}", v, prec);
+}
+
+template <> char *float_digits<'E'>(char *p, double v, int prec)
+{
+  return fmt::format_to(p, "{:.{}E}", v, prec);
+}
+
+template <> char *float_digits<'g'>(char *p, double v, int prec)
+{
+  return fmt::format_to(p, "{:.{}g}", v, prec);
+}
+
+template <> char *float_digits<'G'>(char *p, double v, int prec)
+{
+  return fmt::format_to(p, "{:.{}G}", v, prec);
+}
+
+/* ----------------------------------------------------------------------
+   pad field between start and end with blanks to width
+   return new end of field
+------------------------------------------------------------------------- */
+
+static char *justify(char *start, char *end, int width, int left)
+{
+  int len = end - start;
+  if (len >= width) return end;
+
+  int pad = width - len;
+  if (left) memset(end,' ',pad);
+  else {
+    memmove(start+pad,start,len);
+    memset(start,' ',pad);
+  }
+  return start + width;
+}
+
+/* ----------------------------------------------------------------------
+   keys of 3d cells along Morton (Z-order) and Hilbert curves,
+   CURVEBITS bits per dimension
+------------------------------------------------------------------------- */
+
+static constexpr int CURVEBITS = 17;
+static constexpr uint32_t CURVECELLS = 1u << CURVEBITS;
+
+static uint64_t spread_bits(uint32_t v)
+{
+  uint64_t x = v & 0x1fffff;
+  x = (x | (x << 32)) & 0x1f00000000ffffULL;
+  x = (x | (x << 16)) & 0x1f0000ff0000ffULL;
+  x = (x | (x << 8)) & 0x100f00f00f00f00fULL;
+  x = (x | (x << 4)) & 0x10c30c30c30c30c3ULL;
+  x = (x | (x << 2)) & 0x1249249249249249ULL;
+  return x;
+}
+
+static uint64_t morton_key(const uint32_t *cell)
+{
+  return (spread_bits(cell[0]) << 2) | (spread_bits(cell[1]) << 1) | spread_bits(cell[2]);
+}
+
+// J. Skilling, AIP Conf. Proc. 707, 381 (2004): cell coords to the
+// transposed Hilbert index, whose interleaved bits are the key
+
+static uint64_t hilbert_key(const uint32_t *cell)
+{
+  uint32_t x[3] = {cell[0],cell[1],cell[2]};
+  uint32_t t;
+
+  for (uint32_t q = CURVECELLS >> 1; q > 1; q >>= 1) {
+    uint32_t p = q - 1;
+    for (int i = 0; i < 3; i++) {
+      if (x[i] & q) x[0] ^= p;
+      else {
+        t = (x[0] ^ x[i]) & p;
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+    }
+  }
+
+  x[1] ^= x[0];
+  x[2] ^= x[1];
+  t = 0;
+  for (uint32_t q = CURVECELLS >> 1; q > 1; q >>= 1)
+    if (x[2] & q) t ^= q - 1;
+  for (int i = 0; i < 3; i++) x[i] ^= t;
+
+  return morton_key(x);
+}
 
 /* ---------------------------------------------------------------------- */
 
@@ -36,6 +180,7 @@ DumpEXTXYZ::DumpEXTXYZ(LAMMPS *lmp, int narg, char **arg) : Dump(lmp, narg, arg)
   if (binary || multiproc) error->all(FLERR,"Invalid dump extxyz filename");
 
   size_one = 5;
+  nvalue = 3;
 
   buffer_allow = 1;
   buffer_flag = 1;
@@ -48,12 +193,67 @@ DumpEXTXYZ::DumpEXTXYZ(LAMMPS *lmp, int narg, char **arg) : Dump(lmp, narg, arg)
 
   ntypes = atom->ntypes;
   typenames = nullptr;
+
+  vflag = fflag = 0;
+  for (int igroup = 0; igroup < NGROUP; igroup++) {
+    precconv[igroup] = 'g';
+    precdigits[igroup] = -1;
+  }
+
+  engine = PROGRAM;
+  checkrows = 0;
+  maxline = 0;
+  trace = nullptr;
+
+  order = TAG;
+  idflag = ordersort = 0;
+
+  rowsinks = parsinks = 0;
+  textflag = 1;
+  frameflag = 0;
+  sinkbuf = nullptr;
+  maxsinkbuf = 0;
+  spatial = nullptr;
+  asyncflag = 0;
+  writer = nullptr;
+  stagelimit = 0;
+  stage = nullptr;
+
+  zflag = 0;
+  zlevel = 3;
+  zblock = 4*1024*1024;
+
+  forkmax = 0;
+  forkfd = -1;
+
+  nbatch = 1;
+  streamcap = 0;
+
+  budgetmode = NOBUDGET;
+  budget = 1.0;
+  budgetstart = -1.0;
+  budgetlast = budgettime = 0.0;
+  throttled = 0;
+
+  trigger = NOTRIGGER;
+  threshold = 0.0;
+  triggerevery = 0;
+  triggerlast = -1;
+  id_fix = nullptr;
+  fixref = nullptr;
+
+  counters = nullptr;
 }
 
 /* ---------------------------------------------------------------------- */
 
 DumpEXTXYZ::~DumpEXTXYZ()
 {
+  // snapshots still held by a batch, e.g. after a run stopped early,
+  // all procs delete the dump together
+
+  flush_pending();
+
   delete[] format_default;
   format_default = nullptr;
 
@@ -63,12 +263,209 @@ DumpEXTXYZ::~DumpEXTXYZ()
     delete [] typenames;
     typenames = nullptr;
   }
+
+  for (auto &sink : sinks) delete sink;
+  memory->destroy(sinkbuf);
+  delete spatial;
+
+  // last frames must reach fp before Dump closes it
+
+  delete writer;
+  delete stage;
+
+  if (trace) trace->write();
+  delete trace;
+  if (counters) counters->summary(id);
+  delete counters;
+
+  if (id_fix && modify->nfix) modify->delete_fix(id_fix);
+  delete[] id_fix;
+  reap_children(0);
+#ifdef LAMMPS_ZSTD
+  for (auto ctx : zctx) ZSTD_freeCCtx(ctx);
+#endif
+#if !defined(_WIN32)
+  if (forkfd >= 0) close(forkfd);
+#endif
+}
+
+/* ----------------------------------------------------------------------
+   one snapshot for the dump file and all sinks
+   sinks see the frame opened in write_header() and closed here
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::write()
+{
+  // snapshots before dump_modify delay are not a trigger reference
+
+  if (trigger != NOTRIGGER) {
+    if (delay_flag && update->ntimestep < delaystep) return;
+    if (!trigger_due()) return;
+  }
+
+  double tframe = 0.0;
+  if (trace) {
+    trace->begin_frame(update->ntimestep);
+    tframe = trace->now();
+  }
+
+  double time0 = 0.0;
+  if (budgetmode != NOBUDGET) {
+    time0 = platform::walltime();
+    int over = over_budget(time0);
+
+    if (over && budgetmode == SKIP) {
+      if (spatial && me == 0) spatial->skip(update->ntimestep);
+      if (nbatch > 1 && batch_due()) flush_batch();
+      if (zflag && me == 0) compress_blocks(1);
+      budgetlast = platform::walltime() - time0;
+      if (trace) trace->add("skip",tframe);
+      return;
+    }
+    if (budgetmode == COARSE && over != throttled) program.swap(coarse);
+    throttled = over;
+  }
+  if (trigger != NOTRIGGER) trigger_reset();
+
+  if (nbatch > 1) write_batch();
+  else {
+    frameflag = 0;
+
+    Dump::write();
+
+    // sort and send of other procs, sort and receive of unbuffered rows on proc 0
+
+    if (trace) trace->gap(buffer_flag ? "gather" : "sort, gather");
+    if (frameflag) {
+      double start = trace ? trace->now() : 0.0;
+      for (auto &sink : sinks) sink->end_frame();
+      if (trace) trace->add("sinks",start);
+    }
+    frameflag = 0;
+  }
+
+  // rest of the frame becomes the last, shorter block
+
+  if (zflag && me == 0) {
+    double start = trace ? trace->now() : 0.0;
+    compress_blocks(1);
+    if (flush_flag && !writer && !stage) fflush(fp);
+    if (trace) trace->add("compress",start);
+  }
+
+  double start = trace ? trace->now() : 0.0;
+  if (writer) {
+    if (writer->failed()) error->one(FLERR,"Error writing dump extxyz file {}",filename);
+    writer->submit();
+  }
+  if (stage) {
+    if (stage->failed())
+      error->one(FLERR,"Error staging dump extxyz file {} in {}",filename,stagedir);
+    stage->submit();
+
+    // the run ends with the dump file complete on the parallel filesystem,
+    // with a variable interval at the latest when the next run starts
+
+    if (last_in_run(0)) {
+      stage->finish();
+      if (stage->failed())
+        error->one(FLERR,"Error staging dump extxyz file {} in {}",filename,stagedir);
+    }
+  }
+  if (trace && (writer || stage)) trace->add("submit",start);
+  if (forkmax && me == 0) {
+    start = trace ? trace->now() : 0.0;
+    fork_frame();
+    if (trace) trace->add("fork",start);
+  }
+
+  if (budgetmode != NOBUDGET) budgetlast = platform::walltime() - time0;
+  if (trace) trace->add("frame",tframe);
 }
 
 /* ---------------------------------------------------------------------- */
 
 void DumpEXTXYZ::init_style()
 {
+  // snapshots held since a run that stopped before its last dump step
+  // are written with the settings they were packed with
+
+  flush_pending();
+
+  // per-atom columns: tag, type, pos, optional vel and forces,
+  // space-filling curve key if atoms are not ordered by ID
+  // buf and the sort buffers must be reallocated if the row size changed
+  // since the last run, Dump::sort() only grows them with maxsort
+
+  int size_prev = size_one;
+  nvalue = 3 + 3*vflag + 3*fflag;
+  idflag = (order != TAG);
+  size_one = 2 + nvalue + idflag;
+  if (size_one != size_prev) {
+    memory->destroy(buf);
+    buf = nullptr;
+    maxbuf = 0;
+    memory->destroy(bufsort);
+    memory->destroy(idsort);
+    memory->destroy(Dump::index);
+    bufsort = nullptr;
+    idsort = nullptr;
+    Dump::index = nullptr;
+    maxsort = 0;
+  }
+
+  properties.clear();
+  if (vflag || fflag || idflag) {
+    properties = "Properties=species:S:1:pos:R:3";
+    if (vflag) properties += ":vel:R:3";
+    if (fflag) properties += ":forces:R:3";
+    if (idflag) properties += ":id:I:1";
+  }
+
+  // curve order is a dump sort on the key column, ascending
+  // any earlier sort setting is replaced
+
+  if (idflag) {
+    if (engine == SPRINTF)
+      error->all(FLERR,"Dump_modify order morton or hilbert requires dump_modify engine program");
+    sort_flag = 1;
+    sortcol = size_one;
+    sortcolm1 = size_one - 1;
+    sortorder = ASCEND;
+    ordersort = 1;
+  } else if (ordersort) {
+    sortcol = 0;
+    ordersort = 0;
+  }
+
+  // default line format from the precision of each property group
+
+  int precflag = 0;
+  std::string line = "%s";
+  std::string coarseline = "%s";
+  for (int igroup = 0; igroup < NGROUP; igroup++) {
+    if (igroup == VEL && !vflag) continue;
+    if (igroup == FORCE && !fflag) continue;
+    std::string field = "%g";
+    if (precdigits[igroup] >= 0) {
+      field = fmt::format("%.{}{}",precdigits[igroup],precconv[igroup]);
+      precflag = 1;
+    }
+    for (int k = 0; k < 3; k++) {
+      line += " " + field;
+      coarseline += fmt::format(" %.{}g",COARSEDIGITS);
+    }
+  }
+  if (idflag) {
+    line += " %d";
+    coarseline += " %d";
+  }
+  delete[] format_default;
+  format_default = utils::strdup(line);
+
+  if (format_line_user && precflag)
+    error->all(FLERR,"Dump_modify format line cannot be combined with dump_modify precision");
+
   // format = copy of default or user-specified line format
 
   delete [] format;
@@ -89,22 +486,162 @@ void DumpEXTXYZ::init_style()
     }
   }
 
+  // compile line format into a list of operations
+  // also sets maxline, used by the sprintf engine as well
+
+  // coarse format of budget mode is compiled first and set aside,
+  // maxline must hold lines of either format
+
+  int coarsemax = 0;
+  coarse.clear();
+  coarseline += "\n";
+  if (budgetmode == COARSE) {
+    if (engine == SPRINTF || format_line_user)
+      error->all(FLERR,"Dump_modify budget coarse requires engine program and the default "
+                 "line format");
+    compile_format(coarseline.c_str());
+    coarse.swap(program);
+    coarsemax = maxline;
+  }
+  throttled = 0;
+
+  compile_format(format);
+  maxline = MAX(maxline,coarsemax);
+
+  // fast emitters must reproduce sprintf byte for byte, checked on proc 0
+  // for the line format and the coarse format of budget mode
+  // fallback is not possible where only the compiled format can be used
+
+  if (checkrows && engine == PROGRAM) {
+    int flag = 0;
+    if (me == 0) {
+      flag = check_engine(format);
+      if (flag && budgetmode == COARSE) {
+        program.swap(coarse);
+        flag = check_engine(coarseline.c_str());
+        program.swap(coarse);
+      }
+    }
+    MPI_Bcast(&flag,1,MPI_INT,0,world);
+    if (!flag) {
+      if (idflag || budgetmode == COARSE)
+        error->all(FLERR,"Dump extxyz compiled line format differs from sprintf and "
+                   "dump_modify order or budget coarse require it");
+      if (me == 0)
+        error->warning(FLERR,"Dump extxyz compiled line format differs from sprintf, "
+                       "using dump_modify engine sprintf");
+      engine = SPRINTF;
+    }
+  }
+
   // setup function ptr
 
+  // serial sinks open their files on the proc writing the dump file,
+  // parallel sinks on all procs
+
+  rowsinks = parsinks = 0;
+  for (auto &sink : sinks) {
+    if (sink->parallel) parsinks++;
+    else if (sink->rowflag) rowsinks++;
+    else if (!textflag)
+      error->all(FLERR,"Dump extxyz sink copying the dump text needs dump_modify text yes");
+  }
+  if (parsinks && buffer_flag == 0)
+    error->all(FLERR,"Dump extxyz parallel sinks need dump_modify buffer yes");
+
+  for (auto &sink : sinks)
+    if (me == 0 || sink->parallel) sink->init(ntypes,typenames);
+
+  // the dump compresses a .zst file itself instead of piping it to zstd
+
+  if (zflag) {
+    if (multifile || forkmax)
+      error->all(FLERR,"Dump_modify compress requires a single dump file and no fork");
+    if (compressed && !utils::strmatch(filename,"\\.zst$"))
+      error->all(FLERR,"Dump_modify compress writes zstd, dump file {} has another "
+                 "compression suffix",filename);
+
+    // fp is a plain file once opened, Dump must not pclose it
+
+    if (!singlefile_opened) compressed = 0;
+  }
+
+  // index holds byte offsets of lines of the dump file itself
+
+  if (spatial) {
+    if (buffer_flag == 0 || textflag == 0 || compressed || zflag)
+      error->all(FLERR,"Dump extxyz index needs dump_modify buffer yes and text yes "
+                 "and an uncompressed dump file");
+    spatial->open();
+  }
+
   if (buffer_flag == 1) write_choice = &DumpEXTXYZ::write_string;
   else write_choice = &DumpEXTXYZ::write_lines;
   
-  if (domain->triclinic == 0){
-    header_choice = &DumpEXTXYZ::header_binary;
-    pack_choice = &DumpEXTXYZ::pack;
-  }else if (domain->triclinic == 1){
-    header_choice = &DumpEXTXYZ::header_binary_triclinic;
-    pack_choice = &DumpEXTXYZ::pack_triclinic;
-  }
+  if (domain->triclinic == 0) header_choice = &DumpEXTXYZ::header_binary;
+  else header_choice = &DumpEXTXYZ::header_binary_triclinic;
 
   // open single file, one time only
 
   if (multifile == 0) openfile();
+
+  // writer thread takes over the single open file
+
+  if (asyncflag && multifile)
+    error->all(FLERR,"Dump_modify async requires a single dump file");
+  if (asyncflag && me == 0 && !writer) writer = new ExtxyzWriter(fp,platform::ftell(fp));
+  if (writer) writer->set_trace(trace);
+
+  // frames go to segments in the staging directory, the drain thread
+  // appends them to the single open file
+
+  if (!stagedir.empty()) {
+    if (multifile || asyncflag)
+      error->all(FLERR,"Dump_modify stage requires a single dump file and async no");
+    if (me == 0 && !stage) {
+      if (platform::mkdir(stagedir) != 0)
+        error->one(FLERR,"Cannot create dump extxyz staging directory {}: {}",stagedir,
+                   utils::getsyserror());
+      stage = new ExtxyzStage(fp,platform::ftell(fp),stagedir,
+                              platform::path_basename(filename),stagelimit);
+    }
+    if (stage) stage->set_trace(trace);
+  }
+
+  // children format rows gathered unformatted and write through the
+  // file descriptor fp shares with them
+
+  // reference positions of the displacement trigger
+
+  if (trigger != NOTRIGGER) {
+    if (nbatch > 1) error->all(FLERR,"Dump_modify trigger cannot be used with batch");
+    int ifix = modify->find_fix(id_fix);
+    if (ifix < 0) error->all(FLERR,"Could not find dump extxyz fix ID {}",id_fix);
+    fixref = (FixStore *) modify->fix[ifix];
+  }
+
+  // streamed text is pulled in convert_string(), the gather of
+  // Dump::write() then only moves empty strings
+
+  if (streamcap && (buffer_flag == 0 || nbatch > 1))
+    error->all(FLERR,"Dump_modify stream requires buffer yes and no batch");
+
+  // batched frames bypass the per-frame sort and gather of Dump::write()
+
+  if (nbatch > 1 && (multifile || sinks.size() || spatial || forkmax))
+    error->all(FLERR,"Dump_modify batch requires a single dump file, no sinks, no index and no fork");
+
+  if (forkmax) {
+#if defined(_WIN32)
+    error->all(FLERR,"Dump_modify fork is not supported on Windows");
+#endif
+    if (buffer_flag || asyncflag || spatial || !textflag || !stagedir.empty())
+      error->all(FLERR,"Dump_modify fork requires buffer no, async no, no index, no stage "
+                 "and text yes");
+    for (auto &sink : sinks)
+      if (!sink->rowflag && !sink->parallel)
+        error->all(FLERR,"Dump_modify fork cannot be used with sinks copying the dump text");
+  }
 }
 
 /* ---------------------------------------------------------------------- */
@@ -131,140 +668,1560 @@ int DumpEXTXYZ::modify_param(int narg, char **arg)
     return ntypes+1;
   }
 
-  return 0;
-}
+  if (strcmp(arg[0],"vel") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    vflag = utils::logical(FLERR,arg[1],false,lmp);
+    return 2;
+  }
 
-/* ---------------------------------------------------------------------- */
+  if (strcmp(arg[0],"forces") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    fflag = utils::logical(FLERR,arg[1],false,lmp);
+    return 2;
+  }
 
-void DumpEXTXYZ::write_header(bigint n)
-{
-  if (me == 0) {
-    (this->*header_choice)(n);
+  if (strcmp(arg[0],"precision") == 0) {
+    if (narg < 4) error->all(FLERR,"Illegal dump_modify command");
+    int igroup;
+    if (strcmp(arg[1],"pos") == 0) igroup = POS;
+    else if (strcmp(arg[1],"vel") == 0) igroup = VEL;
+    else if (strcmp(arg[1],"forces") == 0) igroup = FORCE;
+    else error->all(FLERR,"Illegal dump_modify precision group: {}",arg[1]);
+    if (strlen(arg[2]) != 1 || !strchr("feEgG",arg[2][0]))
+      error->all(FLERR,"Illegal dump_modify precision conversion: {}",arg[2]);
+    precconv[igroup] = arg[2][0];
+    precdigits[igroup] = utils::inumeric(FLERR,arg[3],false,lmp);
+    if (precdigits[igroup] < 0 || precdigits[igroup] > 17)
+      error->all(FLERR,"Illegal dump_modify precision digits: {}",arg[3]);
+    return 4;
   }
-}
 
-/* ---------------------------------------------------------------------- */
+  if (strcmp(arg[0],"sink") == 0) {
+    if (narg < 3) error->all(FLERR,"Illegal dump_modify command");
+    ExtxyzSink *sink = nullptr;
+    if (strcmp(arg[1],"extxyz") == 0) sink = new ExtxyzSinkText(lmp,this,arg[2]);
+    else if (strcmp(arg[1],"binary") == 0) sink = new ExtxyzSinkBinary(lmp,this,arg[2]);
+    else if (strcmp(arg[1],"lod") == 0) sink = new ExtxyzSinkLOD(lmp,this,arg[2]);
+    else if (strcmp(arg[1],"latest") == 0) sink = new ExtxyzSinkLatest(lmp,this,arg[2]);
+    else if (strcmp(arg[1],"h5md") == 0) {
+#ifdef EXTXYZ_HDF5
+      sink = new ExtxyzSinkH5MD(lmp,this,arg[2]);
+#else
+      error->all(FLERR,"Dump extxyz sink h5md requires LAMMPS built with -DEXTXYZ_HDF5");
+#endif
+    } else if (strcmp(arg[1],"adios2") == 0) {
+#ifdef EXTXYZ_ADIOS2
+      sink = new ExtxyzSinkADIOS2(lmp,this,arg[2]);
+#else
+      error->all(FLERR,"Dump extxyz sink adios2 requires LAMMPS built with -DEXTXYZ_ADIOS2");
+#endif
+    } else if (strcmp(arg[1],"arrow") == 0) {
+#ifdef EXTXYZ_ARROW
+      sink = new ExtxyzSinkArrow(lmp,this,arg[2]);
+#else
+      error->all(FLERR,"Dump extxyz sink arrow requires LAMMPS built with -DEXTXYZ_ARROW");
+#endif
+    } else error->all(FLERR,"Unknown dump extxyz sink style: {}",arg[1]);
 
-void DumpEXTXYZ::header_binary(bigint n)
-{
-  auto header = fmt::format("{}", n);
-  header += "\n";
-  fmt::print(fp, header);
-  header = fmt::format("Lattice=\"{} 0.0 0.0 0.0 {} 0.0 0.0 0.0 {}\" ", boxxhi-boxxlo, boxyhi-boxylo, boxzhi-boxzlo);
-  header += "\n";
-  fmt::print(fp, header);
-}
+    // sink keywords end at the first one the sink does not know
 
-/* ---------------------------------------------------------------------- */
+    int iarg = 3;
+    while (iarg < narg) {
+      int n = sink->modify_param(narg-iarg,&arg[iarg]);
+      if (n == 0) break;
+      iarg += n;
+    }
+    sinks.push_back(sink);
+    return iarg;
+  }
 
-void DumpEXTXYZ::header_binary_triclinic(bigint n)
-{
-  auto header = fmt::format("{}", n);
-  header += "\n";
-  fmt::print(fp, header);
-  header = fmt::format("Lattice=\"{} 0.0 0.0 0.0 {} 0.0 0.0 0.0 {}\" ", boxxhi-boxxlo, boxyhi-boxylo, boxzhi-boxzlo);
-  header += "\n";
-  fmt::print(fp, header);
-}
+  if (strcmp(arg[0],"index") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    delete spatial;
+    spatial = nullptr;
+    if (strcmp(arg[1],"none") == 0) return 2;
+    if (narg < 3) error->all(FLERR,"Illegal dump_modify command");
+    int ncell = utils::inumeric(FLERR,arg[2],false,lmp);
+    if (ncell < 1 || ncell > 1024) error->all(FLERR,"Illegal dump_modify index cells: {}",arg[2]);
+    spatial = new ExtxyzIndex(lmp,arg[1],ncell);
+    return 3;
+  }
 
+  if (strcmp(arg[0],"async") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    asyncflag = utils::logical(FLERR,arg[1],false,lmp);
+    if (!asyncflag && writer) {
+      delete writer;
+      writer = nullptr;
+    }
+    return 2;
+  }
 
-/* ---------------------------------------------------------------------- */
+  if (strcmp(arg[0],"compress") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
 
-void DumpEXTXYZ::pack(tagint *ids)
-{
-  int m,n;
+    // the file was opened as plain zstd output or as a pipe to zstd,
+    // the other kind of compression cannot append to it
 
-  tagint *tag = atom->tag;
-  int *type = atom->type;
-  int *mask = atom->mask;
-  double **x = atom->x;
-  int nlocal = atom->nlocal;
+    int zflag_new = (strcmp(arg[1],"none") != 0);
+    if (singlefile_opened && zflag_new != zflag)
+      error->all(FLERR,"Dump_modify compress cannot be switched on or off "
+                 "once the dump file is open");
+    if (!zflag_new) {
+      zflag = 0;
+      return 2;
+    }
+#ifdef LAMMPS_ZSTD
+    zlevel = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (zlevel < ZSTD_minCLevel() || zlevel > ZSTD_maxCLevel())
+      error->all(FLERR,"Illegal dump_modify compress level: {}",arg[1]);
+    zflag = 1;
+    if (narg > 3 && strcmp(arg[2],"block") == 0) {
+      double mbytes = utils::numeric(FLERR,arg[3],false,lmp);
+      if (mbytes <= 0.0 || mbytes > 1024.0)
+        error->all(FLERR,"Illegal dump_modify compress block: {}",arg[3]);
+      zblock = MAX(static_cast<bigint>(mbytes*1024.0*1024.0),1);
+      return 4;
+    }
+    return 2;
+#else
+    error->all(FLERR,"Dump_modify compress requires LAMMPS compiled with -DLAMMPS_ZSTD");
+#endif
+  }
 
-  m = n = 0;
-  for (int i = 0; i < nlocal; i++)
-    if (mask[i] & groupbit) {
-      buf[m++] = tag[i];
-      buf[m++] = type[i];
-      buf[m++] = x[i][0]-boxxlo;
-      buf[m++] = x[i][1]-boxylo;
-      buf[m++] = x[i][2]-boxzlo;
-      if (ids) ids[n++] = tag[i];
+  if (strcmp(arg[0],"stage") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    if (stage) {
+      delete stage;
+      stage = nullptr;
     }
-}
+    if (strcmp(arg[1],"none") == 0) {
+      stagedir.clear();
+      return 2;
+    }
+    if (narg < 3) error->all(FLERR,"Illegal dump_modify command");
+    double mbytes = utils::numeric(FLERR,arg[2],false,lmp);
+    if (mbytes <= 0.0) error->all(FLERR,"Illegal dump_modify stage limit: {}",arg[2]);
+    stagedir = arg[1];
+    stagelimit = static_cast<bigint>(mbytes*1024.0*1024.0);
+    return 3;
+  }
 
-/* ---------------------------------------------------------------------- */
+  // a previous trace is written when replaced, threads stop using it first
 
-void DumpEXTXYZ::pack_triclinic(tagint *ids)
-{
-  int m,n;
+  if (strcmp(arg[0],"trace") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    if (trace) {
+      if (writer) writer->set_trace(nullptr);
+      if (stage) stage->set_trace(nullptr);
+      trace->write();
+      delete trace;
+      trace = nullptr;
+    }
+    if (strcmp(arg[1],"none") == 0) return 2;
+    trace = new ExtxyzTrace(lmp,arg[1]);
+    if (writer) writer->set_trace(trace);
+    if (stage) stage->set_trace(trace);
+    return 2;
+  }
 
-  tagint *tag = atom->tag;
-  int *type = atom->type;
-  int *mask = atom->mask;
-  double **x = atom->x;
-  int nlocal = atom->nlocal;
+  // counters are kept only if all procs can open them
 
-  m = n = 0;
-  for (int i = 0; i < nlocal; i++)
-    if (mask[i] & groupbit) {
-      buf[m++] = tag[i];
-      buf[m++] = type[i];
-      buf[m++] = x[i][0];
-      buf[m++] = x[i][1];
-      buf[m++] = x[i][2];
-      if (ids) ids[n++] = tag[i];
+  if (strcmp(arg[0],"counters") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    int flag = utils::logical(FLERR,arg[1],false,lmp);
+    if (flag && !counters) {
+      counters = new ExtxyzCounters(lmp);
+      int mine = counters->available();
+      int all;
+      MPI_Allreduce(&mine,&all,1,MPI_INT,MPI_MIN,world);
+      if (!all) {
+        if (me == 0)
+          error->warning(FLERR,"Dump_modify counters disabled: {}",
+                         mine ? "counters unavailable on some procs" : counters->reason());
+        delete counters;
+        counters = nullptr;
+      }
+    } else if (!flag && counters) {
+      counters->summary(id);
+      delete counters;
+      counters = nullptr;
     }
-}
+    return 2;
+  }
 
-/* ----------------------------------------------------------------------
-   convert mybuf of doubles to one big formatted string in sbuf
-   return -1 if strlen exceeds an int, since used as arg in MPI calls in Dump
-------------------------------------------------------------------------- */
+  if (strcmp(arg[0],"trigger") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    triggerlast = -1;
+    if (strcmp(arg[1],"none") == 0) {
+      trigger = NOTRIGGER;
+      if (id_fix && modify->nfix) modify->delete_fix(id_fix);
+      delete[] id_fix;
+      id_fix = nullptr;
+      fixref = nullptr;
+      return 2;
+    }
+    if (narg < 4) error->all(FLERR,"Illegal dump_modify command");
+    if (strcmp(arg[1],"max") == 0) trigger = MAXDISP;
+    else if (strcmp(arg[1],"rms") == 0) trigger = RMSDISP;
+    else error->all(FLERR,"Illegal dump_modify trigger: {}",arg[1]);
+    threshold = utils::numeric(FLERR,arg[2],false,lmp);
+    if (threshold <= 0.0) error->all(FLERR,"Illegal dump_modify trigger distance: {}",arg[2]);
+    triggerevery = utils::bnumeric(FLERR,arg[3],false,lmp);
+    if (triggerevery < 0) error->all(FLERR,"Illegal dump_modify trigger interval: {}",arg[3]);
 
-int DumpEXTXYZ::convert_string(int n, double *mybuf)
-{
-  int offset = 0;
-  int m = 0;
-  for (int i = 0; i < n; i++) {
-    if (offset + ONELINE > maxsbuf) {
-      if ((bigint) maxsbuf + DELTA > MAXSMALLINT) return -1;
-      maxsbuf += DELTA;
-      memory->grow(sbuf,maxsbuf,"dump:sbuf");
+    if (!id_fix) {
+      id_fix = utils::strdup(std::string(id) + "_DUMP_STORE");
+      modify->add_fix(fmt::format("{} {} STORE peratom 1 3",id_fix,group->names[igroup]));
     }
+    return 4;
+  }
 
-    offset += sprintf(&sbuf[offset],format,
-                      typenames[static_cast<int> (mybuf[m+1])],
-                      mybuf[m+2],mybuf[m+3],mybuf[m+4]);
-    m += size_one;
+  if (strcmp(arg[0],"budget") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    if (strcmp(arg[1],"none") == 0) {
+      budgetmode = NOBUDGET;
+      return 2;
+    }
+    if (narg < 3) error->all(FLERR,"Illegal dump_modify command");
+    budget = utils::numeric(FLERR,arg[1],false,lmp);
+    if (budget <= 0.0 || budget >= 1.0)
+      error->all(FLERR,"Illegal dump_modify budget fraction: {}",arg[1]);
+    if (strcmp(arg[2],"skip") == 0) budgetmode = SKIP;
+    else if (strcmp(arg[2],"coarse") == 0) budgetmode = COARSE;
+    else error->all(FLERR,"Illegal dump_modify budget mode: {}",arg[2]);
+    return 3;
   }
 
-  return offset;
-}
+  if (strcmp(arg[0],"stream") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    if (strcmp(arg[1],"none") == 0) streamcap = 0;
+    else {
+      double mbytes = utils::numeric(FLERR,arg[1],false,lmp);
+      if (mbytes <= 0.0) error->all(FLERR,"Illegal dump_modify stream: {}",arg[1]);
+      streamcap = static_cast<bigint>(mbytes*1024.0*1024.0);
+    }
+    streambuf.clear();
+    streambuf.shrink_to_fit();
+    return 2;
+  }
 
-/* ---------------------------------------------------------------------- */
+  if (strcmp(arg[0],"batch") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    int n = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (n < 1) error->all(FLERR,"Illegal dump_modify batch: {}",arg[1]);
+    if (n < (int) batchframes.size())
+      error->all(FLERR,"Dump_modify batch cannot be reduced while frames are pending");
+    nbatch = n;
+    return 2;
+  }
 
-void DumpEXTXYZ::write_data(int n, double *mybuf)
-{
-  (this->*write_choice)(n,mybuf);
-}
+  if (strcmp(arg[0],"fork") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    forkmax = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (forkmax < 0) error->all(FLERR,"Illegal dump_modify fork: {}",arg[1]);
+    return 2;
+  }
 
-/* ---------------------------------------------------------------------- */
+  if (strcmp(arg[0],"text") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    textflag = utils::logical(FLERR,arg[1],false,lmp);
+    return 2;
+  }
 
-void DumpEXTXYZ::write_string(int n, double *mybuf)
-{
-  if (mybuf)
-    fwrite(mybuf,sizeof(char),n,fp);
-}
+  if (strcmp(arg[0],"order") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    if (strcmp(arg[1],"tag") == 0) order = TAG;
+    else if (strcmp(arg[1],"morton") == 0) order = MORTON;
+    else if (strcmp(arg[1],"hilbert") == 0) order = HILBERT;
+    else error->all(FLERR,"Illegal dump_modify order: {}",arg[1]);
+    return 2;
+  }
 
-/* ---------------------------------------------------------------------- */
+  if (strcmp(arg[0],"engine") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    if (strcmp(arg[1],"sprintf") == 0) engine = SPRINTF;
+    else if (strcmp(arg[1],"program") == 0) engine = PROGRAM;
+    else error->all(FLERR,"Illegal dump_modify engine: {}",arg[1]);
+    return 2;
+  }
 
-void DumpEXTXYZ::write_lines(int n, double *mybuf)
+  if (strcmp(arg[0],"check") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify command");
+    if (strcmp(arg[1],"no") == 0) checkrows = 0;
+    else checkrows = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (checkrows < 0) error->all(FLERR,"Illegal dump_modify check rows: {}",arg[1]);
+    return 2;
+  }
+
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   parse line format once into literal and field operations
+   1st field is the species string, remaining fields are doubles,
+   except one %d ID field if atoms are not dumped in ID order
+   each operation gets its emitter here, so per-atom formatting does not
+   depend on how conversions and precisions are mixed on a line
+   fields without exotic flags or length modifiers take the fast path,
+   all others are formatted by sprintf with their own single-field spec
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::compile_format(const char *str)
+{
+  program.clear();
+  maxline = 0;
+
+  int maxname = 0;
+  for (int itype = 1; itype <= ntypes; itype++)
+    maxname = MAX(maxname,(int) strlen(typenames[itype]));
+
+  std::string literal;
+  int nfield = 0;
+  int nfloat = 0;
+  int nid = 0;
+  const char *p = str;
+
+  while (*p) {
+    if (*p != '%') {
+      literal += *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      literal += '%';
+      p += 2;
+      continue;
+    }
+
+    // one conversion: %[flags][width][.precision][length]conversion
+
+    FormatOp op;
+    const char *start = p++;
+    int exotic = 0;
+
+    op.names = typenames;
+
+    op.left = 0;
+    while (*p && strchr("-+ #0",*p)) {
+      if (*p == '-') op.left = 1;
+      else exotic = 1;
+      p++;
+    }
+
+    op.width = op.prec = -1;
+    if (*p == '*') error->all(FLERR,"Dump extxyz format line cannot use '*' width: {}",str);
+    if (isdigit(*p)) op.width = strtol(p,(char **) &p,10);
+    if (*p == '.') {
+      p++;
+      if (*p == '*') error->all(FLERR,"Dump extxyz format line cannot use '*' precision: {}",str);
+      op.prec = isdigit(*p) ? strtol(p,(char **) &p,10) : 0;
+    }
+    while (*p && strchr("hlLqjzt",*p)) {
+      if (*p != 'l') exotic = 1;
+      p++;
+    }
+    if (*p == '\0') error->all(FLERR,"Invalid dump extxyz format line: {}",str);
+
+    op.conv = *p++;
+    op.text.assign(start,p-start);
+
+    if (!literal.empty()) {
+      FormatOp lit;
+      lit.kind = LITERAL;
+      lit.emit = &emit_literal;
+      lit.col = lit.width = lit.prec = -1;
+      lit.left = 0;
+      lit.conv = '\0';
+      lit.names = nullptr;
+      lit.text = literal;
+      program.push_back(lit);
+      maxline += literal.size();
+      literal.clear();
+    }
+
+    if (nfield == 0) {
+      if (op.conv != 's')
+        error->all(FLERR,"Dump extxyz format line must start with a %s species field: {}",str);
+      op.col = 1;
+      if (exotic || op.prec >= 0) {
+        op.kind = PRINTF;
+        op.emit = &emit_printf;
+      } else {
+        op.kind = SPECIES;
+        op.emit = &emit_species;
+      }
+      maxline += MAX(op.width,maxname);
+    } else if (idflag && (op.conv == 'd' || op.conv == 'i')) {
+      if (exotic || op.prec >= 0 || nid)
+        error->all(FLERR,"Dump extxyz format line has an invalid ID field: {}",str);
+      op.col = 0;
+      op.kind = ID;
+      op.emit = &emit_id;
+      maxline += MAX(op.width,21);
+      nid++;
+    } else {
+      if (!strchr("fFeEgGaA",op.conv))
+        error->all(FLERR,"Dump extxyz format line field {} is not a floating-point "
+                   "conversion: {}",nfield+1,str);
+      op.col = 2 + nfloat++;
+      if (op.col >= 2 + nvalue)
+        error->all(FLERR,"Dump extxyz format line has too many fields: {}",str);
+
+      // %f of a huge double can print ~310 digits before the decimal point
+
+      int prec = (op.prec < 0) ? 6 : op.prec;
+      if (op.conv == 'f' || op.conv == 'F') maxline += MAX(op.width,prec + 320);
+      else maxline += MAX(op.width,prec + 32);
+
+      // fast emitters take the precision as printf applies it
+
+      op.kind = FLOAT;
+      if (op.conv == 'g' || op.conv == 'G') op.prec = MAX(prec,1);
+      else op.prec = prec;
+
+      switch (exotic ? '\0' : op.conv) {
+      case 'f': op.emit = &emit_float<'f'>; break;
+      case 'e': op.emit = &emit_float<'e'>; break;
+      case 'E': op.emit = &emit_float<'E'>; break;
+      case 'g': op.emit = &emit_float<'g'>; break;
+      case 'G': op.emit = &emit_float<'G'>; break;
+      default:
+        op.kind = PRINTF;
+        op.emit = &emit_printf;
+        break;
+      }
+    }
+    nfield++;
+    program.push_back(op);
+  }
+
+  if (!literal.empty()) {
+    FormatOp lit;
+    lit.kind = LITERAL;
+    lit.emit = &emit_literal;
+    lit.col = lit.width = lit.prec = -1;
+    lit.left = 0;
+    lit.conv = '\0';
+    lit.names = nullptr;
+    lit.text = literal;
+    program.push_back(lit);
+    maxline += literal.size();
+  }
+
+  if (nfield == 0)
+    error->all(FLERR,"Dump extxyz format line must start with a %s species field: {}",str);
+  if (idflag && nid == 0)
+    error->all(FLERR,"Dump extxyz format line needs a %d ID field with dump_modify order: {}",str);
+
+  // room for the terminating null written by sprintf
+
+  maxline += 1;
+}
+
+/* ----------------------------------------------------------------------
+   format one atom of packed buf by executing the compiled line format,
+   or with sprintf of the line format for engine sprintf
+   return # of chars written, no terminating null is added
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::format_line(char *line, const double *one)
+{
+  if (engine == SPRINTF) return sprintf_line(line,format,one);
+
+  char *p = line;
+  for (const auto &op : program) p = op.emit(p,op,one);
+  return p - line;
+}
+
+/* ----------------------------------------------------------------------
+   format one atom with a single sprintf of the whole line format str
+   unused trailing values are passed but ignored by sprintf
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::sprintf_line(char *line, const char *str, const double *one)
+{
+  double v[9] = {0.0};
+  for (int k = 0; k < nvalue; k++) v[k] = one[2+k];
+
+  return sprintf(line,str,typenames[static_cast<int> (one[1])],
+                 v[0],v[1],v[2],v[3],v[4],v[5],v[6],v[7],v[8]);
+}
+
+/* ----------------------------------------------------------------------
+   rows of random and adversarial values for check_engine(), all types
+   1st rows cycle every column through values at the edges of printf:
+   signed zeros, denormals, extremes, inf, nan, ties in decimal rounding,
+   and neighbours of the powers of ten where %g switches to exponent form
+   or a precision rounds up to the next power, then random bit patterns
+   and random magnitudes
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::check_rows(std::vector<double> &rows)
+{
+  std::vector<double> edges = {
+    0.0, -0.0, std::numeric_limits<double>::denorm_min(), -std::numeric_limits<double>::denorm_min(),
+    DBL_MIN, DBL_MIN/3.0, -DBL_MIN, DBL_MAX, -DBL_MAX, DBL_EPSILON,
+    std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN(), -std::numeric_limits<double>::quiet_NaN(),
+    0.5, 1.5, 2.5, -2.5, 0.125, 0.375, 1.0e15, 1.0e16, 1.0e21, 1.0e22, 9007199254740993.0,
+    123456789012345678.0, 0.1, 0.2, 0.3, 1.0/3.0, -2.0/3.0};
+
+  for (int e = -310; e <= 310; e++) {
+    double pow10 = std::pow(10.0,e);
+    edges.push_back(pow10);
+    edges.push_back(std::nextafter(pow10,0.0));
+    edges.push_back(-std::nextafter(pow10,HUGE_VAL));
+  }
+
+  // values that round up to a power of ten at the precision of each field
+
+  for (const auto &op : program) {
+    if (op.kind != FLOAT && op.kind != PRINTF) continue;
+    if (op.col < 2) continue;
+    int prec = (op.prec < 0) ? 6 : op.prec;
+    for (int e = -6; e <= prec + 2; e++) {
+      double tie = std::pow(10.0,e) * (1.0 - 0.5*std::pow(10.0,-prec));
+      edges.push_back(tie);
+      edges.push_back(std::nextafter(tie,0.0));
+      edges.push_back(std::nextafter(tie,HUGE_VAL));
+      double half = std::pow(10.0,-prec) * 0.5 * std::pow(10.0,e);
+      edges.push_back(-half);
+    }
+  }
+
+  std::mt19937_64 rng(12345);
+  std::uniform_real_distribution<double> unit(-1.0,1.0);
+  std::uniform_real_distribution<double> decade(-30.0,30.0);
+
+  int nedge = edges.size();
+  int nrows = MAX(checkrows,(nedge + nvalue - 1) / nvalue);
+  rows.assign((bigint) nrows*size_one,0.0);
+  bigint iedge = 0;
+  for (int i = 0; i < nrows; i++) {
+    double *one = &rows[(bigint) i*size_one];
+    one[0] = static_cast<double>(rng() % MAXSMALLINT + 1);
+    one[1] = i % ntypes + 1;
+    for (int k = 0; k < nvalue; k++) {
+      double value;
+      if (iedge < nedge) value = edges[iedge++];
+      else if (rng() & 1) {
+        uint64_t bits = rng();
+        memcpy(&value,&bits,sizeof(double));
+      } else value = unit(rng) * std::pow(10.0,decade(rng));
+      one[2+k] = value;
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------
+   format check rows with the compiled program and with sprintf of the
+   line format str it was compiled from, independently of the compiler,
+   log the throughput of both and the 1st line that differs
+   return 1 if all lines are identical
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::check_engine(const char *str)
+{
+  std::vector<double> rows;
+  check_rows(rows);
+  int nrows = rows.size() / size_one;
+
+  // sprintf cannot print an ID from a double, so a line format with an ID
+  // field is printed in 3 parts: species and floats before the ID field,
+  // the ID as long long with the field's flags and width, floats after it
+
+  std::string head(str), idspec, tail;
+  int nhead = 0;
+  if (idflag) {
+    int nconv = 0;
+    for (const char *p = str; *p; p++) {
+      if (*p != '%') continue;
+      if (p[1] == '%') {
+        p++;
+        continue;
+      }
+      const char *q = p + 1 + strspn(p+1,"-+ #0123456789.hlLqjzt");
+      if (nconv && (*q == 'd' || *q == 'i')) {
+        head.assign(str,p-str);
+        idspec = std::string(p,p + strcspn(p,"hlLqjztdi")) + "lld";
+        tail = q + 1;
+        nhead = nconv - 1;
+        break;
+      }
+      nconv++;
+      p = q;
+    }
+  }
+
+  // blocks of lines keep the buffers small for wide %f fields
+
+  std::vector<char> fast((bigint) CHECKBLOCK*maxline), slow((bigint) CHECKBLOCK*maxline);
+  int nfast[CHECKBLOCK], nslow[CHECKBLOCK];
+  double tfast = 0.0, tslow = 0.0;
+  bigint nbytes = 0;
+
+  for (int first = 0; first < nrows; first += CHECKBLOCK) {
+    int n = MIN(CHECKBLOCK,nrows-first);
+    const double *block = &rows[(bigint) first*size_one];
+
+    double time0 = platform::walltime();
+    char *p = fast.data();
+    for (int i = 0; i < n; i++) {
+      nfast[i] = format_line(p,&block[(bigint) i*size_one]);
+      p += nfast[i];
+    }
+    double time1 = platform::walltime();
+    p = slow.data();
+    for (int i = 0; i < n; i++) {
+      const double *one = &block[(bigint) i*size_one];
+      if (idspec.empty()) nslow[i] = sprintf_line(p,str,one);
+      else {
+        double v[18] = {0.0};
+        for (int k = nhead; k < nvalue; k++) v[k-nhead] = one[2+k];
+        int len = sprintf_line(p,head.c_str(),one);
+        len += sprintf(p+len,idspec.c_str(),(long long) one[0]);
+        len += sprintf(p+len,tail.c_str(),v[0],v[1],v[2],v[3],v[4],v[5],v[6],v[7],v[8]);
+        nslow[i] = len;
+      }
+      p += nslow[i];
+    }
+    double time2 = platform::walltime();
+    tfast += time1 - time0;
+    tslow += time2 - time1;
+
+    const char *a = fast.data();
+    const char *b = slow.data();
+    for (int i = 0; i < n; i++) {
+      if (nfast[i] != nslow[i] || memcmp(a,b,nfast[i]) != 0) {
+        utils::logmesg(lmp,"Dump {} engine check of \"{}\": line {} of {} differs\n"
+                       "  program: {}  sprintf: {}",id,utils::trim(str),first+i+1,nrows,
+                       std::string(a,nfast[i]),std::string(b,nslow[i]));
+        return 0;
+      }
+      a += nfast[i];
+      b += nslow[i];
+      nbytes += nfast[i];
+    }
+  }
+
+  tfast = MAX(tfast,1.0e-9);
+  tslow = MAX(tslow,1.0e-9);
+  utils::logmesg(lmp,"Dump {} engine check of \"{}\": {} lines identical, program {:.3g} "
+                 "Mlines/s {:.3g} MB/s, sprintf {:.3g} Mlines/s {:.3g} MB/s, speedup {:.2f}\n",
+                 id,utils::trim(str),nrows,
+                 1.0e-6*nrows/tfast,1.0e-6*nbytes/tfast,1.0e-6*nrows/tslow,1.0e-6*nbytes/tslow,
+                 tslow/tfast);
+  return 1;
+}
+
+/* ----------------------------------------------------------------------
+   emitters of a compiled line format
+   each writes one operation for one atom and returns the new end of line
+------------------------------------------------------------------------- */
+
+char *DumpEXTXYZ::emit_literal(char *p, const FormatOp &op, const double *)
+{
+  memcpy(p,op.text.data(),op.text.size());
+  return p + op.text.size();
+}
+
+/* ---------------------------------------------------------------------- */
+
+char *DumpEXTXYZ::emit_species(char *p, const FormatOp &op, const double *one)
+{
+  const char *name = op.names[static_cast<int> (one[1])];
+  int len = strlen(name);
+  memcpy(p,name,len);
+  return justify(p,p+len,op.width,op.left);
+}
+
+/* ---------------------------------------------------------------------- */
+
+char *DumpEXTXYZ::emit_printf(char *p, const FormatOp &op, const double *one)
+{
+  if (op.col == 1)
+    return p + sprintf(p,op.text.c_str(),op.names[static_cast<int> (one[1])]);
+  return p + sprintf(p,op.text.c_str(),one[op.col]);
+}
+
+/* ---------------------------------------------------------------------- */
+
+char *DumpEXTXYZ::emit_id(char *p, const FormatOp &op, const double *one)
+{
+  char *end = fmt::format_to(p,"{}",static_cast<tagint> (one[0]));
+  return justify(p,end,op.width,op.left);
+}
+
+/* ---------------------------------------------------------------------- */
+
+template <char CONV>
+char *DumpEXTXYZ::emit_float(char *p, const FormatOp &op, const double *one)
+{
+  char *end = float_digits<CONV>(p,one[op.col],op.prec);
+  return justify(p,end,op.width,op.left);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void DumpEXTXYZ::write_header(bigint n)
+{
+  if (me == 0) {
+    double start = trace ? trace->now() : 0.0;
+    bigint offset = (spatial || sinks.size() > (size_t) parsinks) ? file_offset() : 0;
+    (this->*header_choice)(n);
+    if (spatial) spatial->mark(offset,file_offset());
+    open_frame(n,offset);
+    if (trace) trace->add("header",start);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   start the snapshot of n atoms in the serial sinks on proc 0, offset =
+   where it starts in the dump file
+   called from write_header(), or with dump_modify header no when the
+   1st rows or text reach the sinks; sink files always get a header
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::open_frame(bigint n, bigint offset)
+{
+  if (frameflag || sinks.size() == (size_t) parsinks) return;
+  if (!header_flag) make_comment();
+
+  ExtxyzFrame frame;
+  setup_frame(frame,n);
+  frame.offset = offset;
+  for (auto &sink : sinks)
+    if (!sink->parallel) sink->begin_frame(frame);
+  frameflag = 1;
+}
+
+/* ----------------------------------------------------------------------
+   comment line of the current snapshot
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::make_comment()
+{
+  comment = fmt::format("Lattice=\"{} 0.0 0.0 0.0 {} 0.0 0.0 0.0 {}\" ", boxxhi-boxxlo, boxyhi-boxylo, boxzhi-boxzlo);
+  if (trigger != NOTRIGGER) comment += fmt::format("Timestep={} ",update->ntimestep);
+  comment += properties;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void DumpEXTXYZ::header_binary(bigint n)
+{
+  make_comment();
+  if (textflag) {
+    std::string head = fmt::format("{}\n{}\n",n,comment);
+    write_bytes(head.data(),head.size());
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void DumpEXTXYZ::header_binary_triclinic(bigint n)
+{
+  make_comment();
+  if (textflag) {
+    std::string head = fmt::format("{}\n{}\n",n,comment);
+    write_bytes(head.data(),head.size());
+  }
+}
+
+
+/* ---------------------------------------------------------------------- */
+
+void DumpEXTXYZ::pack(tagint *ids)
 {
+  int m,n;
+  double start = trace ? trace->now() : 0.0;
+  if (counters) counters->start();
+
+  tagint *tag = atom->tag;
+  int *type = atom->type;
+  int *mask = atom->mask;
+  double **x = atom->x;
+  double **v = atom->v;
+  double **f = atom->f;
+  int nlocal = atom->nlocal;
+
+  m = n = 0;
+  for (int i = 0; i < nlocal; i++)
+    if (mask[i] & groupbit) {
+      buf[m++] = tag[i];
+      buf[m++] = type[i];
+      buf[m++] = x[i][0]-boxxlo;
+      buf[m++] = x[i][1]-boxylo;
+      buf[m++] = x[i][2]-boxzlo;
+      if (vflag) {
+        buf[m++] = v[i][0];
+        buf[m++] = v[i][1];
+        buf[m++] = v[i][2];
+      }
+      if (fflag) {
+        buf[m++] = f[i][0];
+        buf[m++] = f[i][1];
+        buf[m++] = f[i][2];
+      }
+      if (idflag) buf[m++] = curve_key(x[i]);
+      if (ids) ids[n++] = tag[i];
+    }
+
+  if (counters) counters->stop(ExtxyzCounters::PACK,nme);
+  if (trace) trace->add("pack",start);
+}
+
+/* ----------------------------------------------------------------------
+   position of an atom along the space-filling curve of the dump order
+   box is divided into 2^17 cells per dimension, the 51-bit key is exact
+   as a double, so the dump sort on the key column orders by cell
+------------------------------------------------------------------------- */
+
+double DumpEXTXYZ::curve_key(double *x)
+{
+  double lamda[3];
+  if (domain->triclinic) domain->x2lamda(x,lamda);
+  else
+    for (int dim = 0; dim < 3; dim++)
+      lamda[dim] = (x[dim] - domain->boxlo[dim]) / domain->prd[dim];
+
+  uint32_t cell[3];
+  for (int dim = 0; dim < 3; dim++) {
+    double c = lamda[dim] * CURVECELLS;
+    cell[dim] = (c <= 0.0) ? 0 : (c >= CURVECELLS-1) ? CURVECELLS-1 : static_cast<uint32_t>(c);
+  }
+
+  if (order == HILBERT) return static_cast<double>(hilbert_key(cell));
+  return static_cast<double>(morton_key(cell));
+}
+
+/* ----------------------------------------------------------------------
+   convert mybuf of doubles to one big formatted string in sbuf
+   packed rows are first collected for sinks that consume them
+   return -1 if strlen exceeds an int, since used as arg in MPI calls in Dump
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::convert_string(int n, double *mybuf)
+{
+  if (trace) trace->gap("sort");
+  if (counters) counters->start();
+
+  if (parsinks || rowsinks) {
+    double start = trace ? trace->now() : 0.0;
+    if (parsinks) write_parallel(n,mybuf);
+    if (rowsinks) gather_rows(n,mybuf);
+    if (trace) trace->add("sinks",start);
+  }
+  if (!textflag) {
+    if (counters) counters->stop(ExtxyzCounters::CONVERT);
+    return 0;
+  }
+  // rows are packed relative to boxlo, the bounding box of a triclinic
+  // cell, so cells of the index start at 0
+
+  if (spatial) {
+    double origin[3] = {0.0,0.0,0.0};
+    double edges[3] = {boxxhi-boxxlo,boxyhi-boxylo,boxzhi-boxzlo};
+    spatial->begin_local(origin,edges);
+  }
+
+  double start = trace ? trace->now() : 0.0;
+  int offset = (streamcap) ? stream_lines(n,mybuf) : format_lines(n,mybuf);
+  if (spatial) spatial->write(update->ntimestep,ntotal);
+  if (counters) counters->stop(ExtxyzCounters::CONVERT);
+  if (trace) trace->add("convert_string",start);
+  return offset;
+}
+
+/* ----------------------------------------------------------------------
+   format n packed rows into sbuf
+   return -1 if strlen exceeds an int
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::format_lines(int n, double *mybuf)
+{
+  int offset = 0;
   int m = 0;
   for (int i = 0; i < n; i++) {
-    fprintf(fp,format,
-            typenames[static_cast<int> (mybuf[m+1])],
-            mybuf[m+2],mybuf[m+3],mybuf[m+4]);
+    if (offset + maxline > maxsbuf) {
+      if ((bigint) maxsbuf + DELTA > MAXSMALLINT) return -1;
+      maxsbuf += DELTA;
+      memory->grow(sbuf,maxsbuf,"dump:sbuf");
+    }
+
+    int len = format_line(&sbuf[offset],&mybuf[m]);
+    if (spatial) spatial->add(&mybuf[m],len);
+    offset += len;
     m += size_one;
   }
+
+  return offset;
+}
+
+/* ----------------------------------------------------------------------
+   format my rows in chunks and write them on proc 0 in proc order
+   proc 0 writes its own chunks, then keeps NWINDOW receives posted and
+   writes the oldest one when it completes; a proc starts sending when the
+   receive for its 1st chunk is posted, with synchronous sends, so no proc
+   ever buffers more than one chunk per window slot on proc 0
+   every chunk holds at most chunk bytes: the cap is split between sbuf
+   and the window; it bounds the text only, buf of packed rows is sized
+   by Dump::write() for the largest # of rows of any proc
+   return 0, nothing is left for the gather of Dump::write()
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::stream_lines(int n, double *mybuf)
+{
+  int tmp = 0;
+  int nchars;
+  bigint chunk = MAX(streamcap / (NWINDOW+1),(bigint) maxline);
+  if (chunk > MAXSMALLINT) chunk = MAXSMALLINT;
+  int rowsper = MAX(1,(int) (chunk / maxline));
+
+  std::vector<int> nrows(me == 0 ? nprocs : 0);
+  MPI_Gather(&n,1,MPI_INT,nrows.data(),1,MPI_INT,0,world);
+
+  if (me != 0) {
+    if (n == 0) return 0;
+    MPI_Recv(&tmp,0,MPI_INT,0,0,world,MPI_STATUS_IGNORE);
+    for (int i = 0; i < n; i += rowsper) {
+      nchars = format_lines(MIN(rowsper,n-i),&mybuf[(bigint) i*size_one]);
+      MPI_Ssend(sbuf,nchars,MPI_CHAR,0,0,world);
+    }
+    return 0;
+  }
+
+  for (int i = 0; i < n; i += rowsper) {
+    nchars = format_lines(MIN(rowsper,n-i),&mybuf[(bigint) i*size_one]);
+    write_string(nchars,(double *) sbuf);
+  }
+
+  // source proc of every chunk in file order
+
+  std::vector<int> source;
+  for (int iproc = 1; iproc < nprocs; iproc++)
+    for (int i = 0; i < nrows[iproc]; i += rowsper) source.push_back(iproc);
+
+  int nchunk = source.size();
+  if ((bigint) streambuf.size() < NWINDOW*chunk) streambuf.resize(NWINDOW*chunk);
+
+  MPI_Request requests[NWINDOW];
+  MPI_Status status;
+  int nposted = 0;
+  auto post = [&]() {
+    int iproc = source[nposted];
+    int slot = nposted % NWINDOW;
+    MPI_Irecv(&streambuf[slot*chunk],(int) chunk,MPI_CHAR,iproc,0,world,&requests[slot]);
+    if (nposted == 0 || source[nposted-1] != iproc) MPI_Send(&tmp,0,MPI_INT,iproc,0,world);
+    nposted++;
+  };
+
+  while (nposted < nchunk && nposted < NWINDOW) post();
+  for (int ichunk = 0; ichunk < nchunk; ichunk++) {
+    int slot = ichunk % NWINDOW;
+    MPI_Wait(&requests[slot],&status);
+    MPI_Get_count(&status,MPI_CHAR,&nchars);
+    write_string(nchars,(double *) &streambuf[slot*chunk]);
+    if (nposted < nchunk) post();
+  }
+
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   send the sorted rows of all procs, in proc order, to sinks on proc 0
+   called by all procs, uses the same ping/send handshake as Dump::write()
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::gather_rows(int n, double *mybuf)
+{
+  int tmp,nrecv;
+  MPI_Status status;
+
+  if (me == 0) {
+    feed_rows(n,mybuf);
+    for (int iproc = 1; iproc < nprocs; iproc++) {
+      MPI_Send(&tmp,0,MPI_INT,iproc,0,world);
+      MPI_Probe(iproc,0,world,&status);
+      MPI_Get_count(&status,MPI_DOUBLE,&nrecv);
+      if (nrecv > maxsinkbuf) {
+        maxsinkbuf = nrecv;
+        memory->destroy(sinkbuf);
+        memory->create(sinkbuf,maxsinkbuf,"dump:sinkbuf");
+      }
+      MPI_Recv(sinkbuf,nrecv,MPI_DOUBLE,iproc,0,world,MPI_STATUS_IGNORE);
+      feed_rows(nrecv/size_one,sinkbuf);
+    }
+  } else {
+    MPI_Recv(&tmp,0,MPI_INT,0,0,world,MPI_STATUS_IGNORE);
+    MPI_Send(mybuf,n*size_one,MPI_DOUBLE,0,0,world);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   parallel sinks write the sorted rows of each proc directly
+   called by all procs after the sort, offset = global index of my 1st row
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::write_parallel(int n, double *mybuf)
+{
+  bigint bn = n;
+  bigint offset = 0;
+  MPI_Exscan(&bn,&offset,1,MPI_LMP_BIGINT,MPI_SUM,world);
+  if (me == 0) offset = 0;
+
+  ExtxyzFrame frame;
+  setup_frame(frame,ntotal);
+  for (auto &sink : sinks)
+    if (sink->parallel) sink->write_local(frame,n,mybuf,offset);
+}
+
+/* ----------------------------------------------------------------------
+   description of the current snapshot for sinks
+   comment line is only set on proc 0
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::setup_frame(ExtxyzFrame &frame, bigint n)
+{
+  frame.ntimestep = update->ntimestep;
+  frame.natoms = n;
+  for (int k = 0; k < 9; k++) frame.lattice[k] = 0.0;
+  frame.lattice[0] = boxxhi - boxxlo;
+  frame.lattice[4] = boxyhi - boxylo;
+  frame.lattice[8] = boxzhi - boxzlo;
+  frame.comment = comment;
+  frame.offset = -1;
+  frame.size_one = size_one;
+  frame.nvalue = nvalue;
+  frame.vflag = vflag;
+  frame.fflag = fflag;
+  frame.idflag = idflag;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void DumpEXTXYZ::feed_rows(int n, double *mybuf)
+{
+  open_frame(ntotal,file_offset());
+  for (auto &sink : sinks)
+    if (sink->rowflag) sink->write_rows(n,mybuf);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void DumpEXTXYZ::write_data(int n, double *mybuf)
+{
+  if (trace) trace->gap(buffer_flag ? "gather" : "sort, gather");
+  double start = trace ? trace->now() : 0.0;
+  if (counters) counters->start();
+  (this->*write_choice)(n,mybuf);
+  if (counters) counters->stop(ExtxyzCounters::WRITE);
+  if (trace) trace->add("write",start);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void DumpEXTXYZ::write_string(int n, double *mybuf)
+{
+  if (mybuf) {
+    open_frame(ntotal,file_offset());
+    write_bytes((char *) mybuf,n);
+    for (auto &sink : sinks)
+      if (!sink->rowflag) sink->write_text((char *) mybuf,n);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   unbuffered output: rows of all procs arrive here on proc 0,
+   so sinks get them without the extra gather of convert_string()
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::write_lines(int n, double *mybuf)
+{
+  feed_rows(n,mybuf);
+  if (!textflag) return;
+
+  if (forkmax) {
+    forkrows.insert(forkrows.end(),mybuf,mybuf + (bigint) n*size_one);
+    return;
+  }
+
+  int nchars = format_lines(n,mybuf);
+  if (nchars < 0) error->one(FLERR,"Too much per-proc info for dump");
+  write_string(nchars,(double *) sbuf);
+}
+
+/* ----------------------------------------------------------------------
+   text of the dump file, held for compression if the dump compresses it
+   a full block per thread is compressed as soon as it is there, so the
+   held text stays bounded for any frame size
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::write_bytes(const char *str, size_t n)
+{
+  if (zflag) {
+    ztext.insert(ztext.end(),str,str+n);
+    if ((bigint) ztext.size() >= comm->nthreads*zblock) compress_blocks(0);
+  } else put_bytes(str,n);
+}
+
+/* ----------------------------------------------------------------------
+   bytes of the dump file go to fp or to the frame of the writer thread
+   or of the staging directory
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::put_bytes(const char *str, size_t n)
+{
+  if (writer) writer->append(str,n);
+  else if (stage) stage->append(str,n);
+  else if (forkmax) forkhead.append(str,n);
+  else fwrite(str,sizeof(char),n,fp);
+}
+
+/* ----------------------------------------------------------------------
+   compress the full blocks of held text concurrently, and the rest as a
+   last block if final, then write them in order, called on proc 0
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::compress_blocks(int final)
+{
+#ifdef LAMMPS_ZSTD
+  bigint nbytes = ztext.size();
+  int nblock = nbytes / zblock;
+  if (final && nbytes % zblock) nblock++;
+  if (nblock == 0) return;
+
+  // one compression context per thread, kept for the whole run
+
+  int nthreads = 1;
+#if defined(_OPENMP)
+  nthreads = omp_get_max_threads();
+#endif
+  while ((int) zctx.size() < nthreads) {
+    zctx.push_back(ZSTD_createCCtx());
+    if (zctx.back() == nullptr) error->one(FLERR,"Cannot create zstd compression context");
+  }
+
+  zout.resize(MAX((int) zout.size(),nblock));
+  int flag = 0;
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) reduction(|:flag)
+#endif
+  for (int i = 0; i < nblock; i++) {
+    int tid = 0;
+#if defined(_OPENMP)
+    tid = omp_get_thread_num();
+#endif
+    bigint first = (bigint) i*zblock;
+    size_t n = MIN(zblock,nbytes-first);
+    std::vector<char> &out = zout[i];
+    out.resize(ZSTD_compressBound(n));
+    size_t m = ZSTD_compressCCtx(zctx[tid],out.data(),out.size(),&ztext[first],n,zlevel);
+    if (ZSTD_isError(m)) flag = 1;
+    else out.resize(m);
+  }
+  if (flag) error->one(FLERR,"Error compressing dump extxyz file {}",filename);
+
+  for (int i = 0; i < nblock; i++) put_bytes(zout[i].data(),zout[i].size());
+  ztext.erase(ztext.begin(),ztext.begin() + MIN((bigint) nblock*zblock,nbytes));
+#endif
+}
+
+/* ----------------------------------------------------------------------
+   fork a child that formats and writes the staged frame, parent returns
+   children write in frame order: each waits for EOF or a byte on the pipe
+   of the previous child before appending to the file
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::fork_frame()
+{
+#if !defined(_WIN32)
+  if (forkhead.empty() && forkrows.empty()) return;
+
+  if (reap_children(forkmax-1))
+    error->one(FLERR,"Forked writer of dump extxyz file {} failed",filename);
+
+  // nothing may sit in the stdio buffer of fp when the image is copied
+
+  fflush(fp);
+  int pipefd[2];
+  if (pipe(pipefd) < 0)
+    error->one(FLERR,"Dump extxyz cannot create pipe: {}",utils::getsyserror());
+
+  pid_t pid = fork();
+  if (pid < 0) error->one(FLERR,"Dump extxyz cannot fork: {}",utils::getsyserror());
+
+  if (pid == 0) {
+    close(pipefd[0]);
+
+    std::vector<char> text(forkhead.begin(),forkhead.end());
+    bigint n = forkrows.size() / size_one;
+    for (bigint i = 0; i < n; i++) {
+      size_t offset = text.size();
+      text.resize(offset + maxline);
+      text.resize(offset + format_line(&text[offset],&forkrows[i*size_one]));
+    }
+
+    char token = 1;
+    if (forkfd >= 0)
+      while (read(forkfd,&token,1) < 0 && errno == EINTR) continue;
+
+    int status = 0;
+    int fd = fileno(fp);
+    for (size_t done = 0; done < text.size();) {
+      ssize_t m = ::write(fd,&text[done],text.size()-done);
+      if (m < 0 && errno == EINTR) continue;
+      if (m < 0) {
+        status = 1;
+        break;
+      }
+      done += m;
+    }
+
+    while (::write(pipefd[1],&token,1) < 0 && errno == EINTR) continue;
+    _exit(status);
+  }
+
+  close(pipefd[1]);
+  if (forkfd >= 0) close(forkfd);
+  forkfd = pipefd[0];
+  children.push_back(pid);
+
+  forkhead.clear();
+  forkrows.clear();
+#endif
+}
+
+/* ----------------------------------------------------------------------
+   wait for the oldest children until at most nmax are running
+   return # of children that failed
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::reap_children(int nmax)
+{
+  int nfail = 0;
+#if !defined(_WIN32)
+  while ((int) children.size() > nmax) {
+    int status = 0;
+    pid_t pid = children.front();
+    while (waitpid(pid,&status,0) < 0 && errno == EINTR) continue;
+    children.erase(children.begin());
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) nfail++;
+  }
+#endif
+  return nfail;
+}
+
+/* ----------------------------------------------------------------------
+   1 if a frame is due: the 1st one, the max interval has passed or the
+   max or RMS displacement of group atoms since the last written frame
+   exceeds the threshold, same result on all procs
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::trigger_due()
+{
+  if (triggerlast < 0) return 1;
+  if (triggerevery && update->ntimestep - triggerlast >= triggerevery) return 1;
+
+  double **x = atom->x;
+  imageint *image = atom->image;
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
+  double **xref = fixref->astore;
+
+  double unwrap[3];
+  double local[2] = {0.0,0.0};
+  for (int i = 0; i < nlocal; i++)
+    if (mask[i] & groupbit) {
+      domain->unmap(x[i],image[i],unwrap);
+      double dx = unwrap[0] - xref[i][0];
+      double dy = unwrap[1] - xref[i][1];
+      double dz = unwrap[2] - xref[i][2];
+      double rsq = dx*dx + dy*dy + dz*dz;
+      if (trigger == MAXDISP) local[0] = MAX(local[0],rsq);
+      else {
+        local[0] += rsq;
+        local[1] += 1.0;
+      }
+    }
+
+  double all[2] = {0.0,0.0};
+  double disp;
+  if (trigger == MAXDISP) {
+    MPI_Allreduce(local,all,1,MPI_DOUBLE,MPI_MAX,world);
+    disp = sqrt(all[0]);
+  } else {
+    MPI_Allreduce(local,all,2,MPI_DOUBLE,MPI_SUM,world);
+    disp = (all[1] > 0.0) ? sqrt(all[0]/all[1]) : 0.0;
+  }
+  return (disp > threshold) ? 1 : 0;
+}
+
+/* ----------------------------------------------------------------------
+   current positions become the reference of the next trigger
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::trigger_reset()
+{
+  double **x = atom->x;
+  imageint *image = atom->image;
+  int *mask = atom->mask;
+  int nlocal = atom->nlocal;
+  double **xref = fixref->astore;
+
+  for (int i = 0; i < nlocal; i++)
+    if (mask[i] & groupbit) domain->unmap(x[i],image[i],xref[i]);
+  triggerlast = update->ntimestep;
+}
+
+/* ----------------------------------------------------------------------
+   1 if time in write() so far exceeds the budget fraction of the wall
+   time since the 1st frame, same result on all procs
+   the time of the previous frame is reduced here, so one collective per
+   frame serves both the decision and the accounting
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::over_budget(double now)
+{
+  if (budgetstart < 0.0) budgetstart = now;
+
+  double local[2] = {budgetlast,now - budgetstart};
+  double all[2];
+  MPI_Allreduce(local,all,2,MPI_DOUBLE,MPI_MAX,world);
+  budgetlast = 0.0;
+  budgettime += all[0];
+
+  int over = (budgettime > budget*all[1]) ? 1 : 0;
+  if (over != throttled && me == 0) {
+    if (over)
+      utils::logmesg(lmp,"Dump {} over budget at step {}: {:.3g} of {:.3g} s, {} frames\n",id,
+                     update->ntimestep,budgettime,all[1],
+                     (budgetmode == SKIP) ? "skipping" : "coarse");
+    else
+      utils::logmesg(lmp,"Dump {} within budget at step {}: {:.3g} of {:.3g} s\n",id,
+                     update->ntimestep,budgettime,all[1]);
+  }
+  return over;
+}
+
+/* ----------------------------------------------------------------------
+   pack my rows of one snapshot and keep them until the batch is due
+   same delay and box handling as Dump::write()
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::write_batch()
+{
+  if (delay_flag && update->ntimestep < delaystep) return;
+
+  if (domain->triclinic == 0) {
+    boxxlo = domain->boxlo[0];
+    boxxhi = domain->boxhi[0];
+    boxylo = domain->boxlo[1];
+    boxyhi = domain->boxhi[1];
+    boxzlo = domain->boxlo[2];
+    boxzhi = domain->boxhi[2];
+  } else {
+    boxxlo = domain->boxlo_bound[0];
+    boxxhi = domain->boxhi_bound[0];
+    boxylo = domain->boxlo_bound[1];
+    boxyhi = domain->boxhi_bound[1];
+    boxzlo = domain->boxlo_bound[2];
+    boxzhi = domain->boxhi_bound[2];
+    boxxy = domain->xy;
+    boxxz = domain->xz;
+    boxyz = domain->yz;
+  }
+
+  nme = count();
+  if (nme > maxbuf) {
+    if ((bigint) nme * size_one > MAXSMALLINT)
+      error->all(FLERR,"Too much per-proc info for dump");
+    maxbuf = nme;
+    memory->destroy(buf);
+    memory->create(buf,(maxbuf*size_one),"dump:buf");
+  }
+  pack(nullptr);
+
+  BatchFrame frame;
+  double box[9] = {boxxlo,boxxhi,boxylo,boxyhi,boxzlo,boxzhi,boxxy,boxxz,boxyz};
+  for (int k = 0; k < 9; k++) frame.box[k] = box[k];
+  frame.nlocal = nme;
+  batchframes.push_back(frame);
+  batchrows.insert(batchrows.end(),buf,buf + (bigint) nme*size_one);
+
+  if (batch_due()) flush_batch();
+}
+
+/* ----------------------------------------------------------------------
+   1 if the batch is full or no later snapshot of this dump falls into
+   the current run, same result on all procs
+   snapshots on variable steps or outside the output list are not held
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::batch_due()
+{
+  if ((int) batchframes.size() >= nbatch) return 1;
+  return last_in_run(1);
+}
+
+/* ----------------------------------------------------------------------
+   write the held snapshots of a batch outside of write()
+   called by all procs, which hold the same # of snapshots
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::flush_pending()
+{
+  if (batchframes.empty()) return;
+
+  flush_batch();
+  if (me == 0) {
+    if (zflag) compress_blocks(1);
+    if (writer) writer->submit();
+    if (stage) stage->submit();
+  }
+}
+
+/* ----------------------------------------------------------------------
+   1 if no later snapshot of this dump falls into the current run,
+   unknown if the next snapshot cannot be predicted
+------------------------------------------------------------------------- */
+
+int DumpEXTXYZ::last_in_run(int unknown)
+{
+  for (int idump = 0; idump < output->ndump; idump++) {
+    if (output->dump[idump] != this) continue;
+    bigint every = output->every_dump[idump];
+    if (every <= 0) return unknown;
+    bigint next = (update->ntimestep/every)*every + every;
+    return (next > update->laststep) ? 1 : 0;
+  }
+  return unknown;
+}
+
+/* ----------------------------------------------------------------------
+   gather the rows of all pending frames on proc 0 in one collective,
+   then order, format and write them frame by frame
+   rows of a frame are in proc order as in Dump::write(), sorted by the
+   dump sort column if set, ties broken by atom ID
+------------------------------------------------------------------------- */
+
+void DumpEXTXYZ::flush_batch()
+{
+  int nframe = batchframes.size();
+  if (nframe == 0) return;
+  double start = trace ? trace->now() : 0.0;
+
+  bigint nmine = batchrows.size();
+  bigint nall;
+  MPI_Allreduce(&nmine,&nall,1,MPI_LMP_BIGINT,MPI_SUM,world);
+  if (nall > MAXSMALLINT)
+    error->all(FLERR,"Dump_modify batch of {} frames is too large for one gather",nframe);
+
+  std::vector<int> mycounts(nframe);
+  for (int iframe = 0; iframe < nframe; iframe++) mycounts[iframe] = batchframes[iframe].nlocal;
+  std::vector<int> allcounts(me == 0 ? (bigint) nframe*nprocs : 0);
+  MPI_Gather(mycounts.data(),nframe,MPI_INT,allcounts.data(),nframe,MPI_INT,0,world);
+
+  std::vector<int> recvcounts(nprocs), displs(nprocs);
+  std::vector<double> rows(me == 0 ? nall : 0);
+  if (me == 0) {
+    int total = 0;
+    for (int iproc = 0; iproc < nprocs; iproc++) {
+      int nrows = 0;
+      for (int iframe = 0; iframe < nframe; iframe++) nrows += allcounts[iproc*nframe+iframe];
+      recvcounts[iproc] = nrows*size_one;
+      displs[iproc] = total;
+      total += recvcounts[iproc];
+    }
+  }
+  MPI_Gatherv(batchrows.data(),(int) nmine,MPI_DOUBLE,rows.data(),recvcounts.data(),
+              displs.data(),MPI_DOUBLE,0,world);
+
+  batchrows.clear();
+  if (trace) trace->add("gather",start);
+
+  if (me == 0) {
+    start = trace ? trace->now() : 0.0;
+    std::vector<int> cursor(displs);
+    std::vector<int> perm;
+    std::vector<double> frame;
+    int col = (sortcol == 0) ? 0 : sortcolm1;
+
+    for (int iframe = 0; iframe < nframe; iframe++) {
+      perm.clear();
+      for (int iproc = 0; iproc < nprocs; iproc++) {
+        int nrows = allcounts[iproc*nframe+iframe];
+        for (int i = 0; i < nrows; i++) perm.push_back(cursor[iproc] + i*size_one);
+        cursor[iproc] += nrows*size_one;
+      }
+
+      if (sort_flag) {
+        int descend = (sortcol != 0 && sortorder == DESCEND);
+        std::stable_sort(perm.begin(),perm.end(),[&](int a, int b) {
+          double ka = rows[a+col];
+          double kb = rows[b+col];
+          if (ka == kb) return rows[a] < rows[b];
+          return descend ? ka > kb : ka < kb;
+        });
+      }
+
+      int n = perm.size();
+      frame.resize((bigint) n*size_one);
+      for (int i = 0; i < n; i++)
+        std::copy(&rows[perm[i]],&rows[perm[i]] + size_one,&frame[(bigint) i*size_one]);
+
+      const double *box = batchframes[iframe].box;
+      boxxlo = box[0];
+      boxxhi = box[1];
+      boxylo = box[2];
+      boxyhi = box[3];
+      boxzlo = box[4];
+      boxzhi = box[5];
+      boxxy = box[6];
+      boxxz = box[7];
+      boxyz = box[8];
+      ntotal = n;
+
+      (this->*header_choice)(n);
+      int nchars = format_lines(n,frame.data());
+      if (nchars < 0) error->one(FLERR,"Too much per-proc info for dump");
+      write_string(nchars,(double *) sbuf);
+    }
+
+    if (flush_flag && !writer && !stage) fflush(fp);
+    if (trace) trace->add("write batch",start);
+  }
+
+  batchframes.clear();
+}
+
+/* ----------------------------------------------------------------------
+   offset in the dump file of the next byte written on proc 0
+   -1 if there is no such offset: no text, compressed or forked output
+------------------------------------------------------------------------- */
+
+bigint DumpEXTXYZ::file_offset()
+{
+  if (!textflag || compressed || zflag || forkmax) return -1;
+  if (writer) return writer->tell();
+  if (stage) return stage->tell();
+  return platform::ftell(fp);
+}
+
+/* ---------------------------------------------------------------------- */
+
+double DumpEXTXYZ::memory_usage()
+{
+  double bytes = Dump::memory_usage();
+  bytes += (double) maxsinkbuf * sizeof(double);
+  for (auto &sink : sinks) bytes += sink->memory_usage();
+  if (spatial) bytes += spatial->memory_usage();
+  if (writer) bytes += writer->memory_usage();
+  bytes += (double) forkrows.capacity() * sizeof(double);
+  bytes += (double) batchrows.capacity() * sizeof(double);
+  bytes += (double) streambuf.capacity();
+  bytes += (double) ztext.capacity();
+  for (auto &block : zout) bytes += (double) block.capacity();
+  if (trace) bytes += trace->memory_usage();
+  return bytes;
 }
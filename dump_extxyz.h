@@ -22,27 +22,170 @@ DumpStyle(extxyz,DumpEXTXYZ);
 
 #include "dump.h"
 
+#include <string>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+
 namespace LAMMPS_NS {
 
 class DumpEXTXYZ : public Dump {
  public:
   DumpEXTXYZ(class LAMMPS *, int, char **);
   ~DumpEXTXYZ() override;
+  void write() override;
+  double memory_usage() override;
+
+  // also used by sinks that format their own lines
+
+  int format_line(char *, const double *);
+  int maxline;                  // upper bound on chars in one line
+  bigint file_offset();
+  class ExtxyzTrace *trace;     // timeline of dump phases, nullptr if none
 
  protected:
   int ntypes;
   char **typenames;
 
+  // optional per-atom property groups after species and positions
+
+  enum { POS, VEL, FORCE, NGROUP };
+
+  int vflag, fflag;             // 1 if velocities, forces are dumped
+  int nvalue;                   // # of per-atom doubles on one line
+  char precconv[NGROUP];        // conversion of each property group
+  int precdigits[NGROUP];       // precision of each group, -1 for %g
+  std::string properties;       // Properties= entry of comment line
+  std::string comment;          // comment line of current frame
+
+  // atom order of a frame: by ID or along a space-filling curve,
+  // the curve key is an extra column after the values and the sort column
+
+  enum { TAG, MORTON, HILBERT };
+
+  int order;                    // TAG, MORTON or HILBERT
+  int idflag;                   // 1 if ID is a property column, key is packed
+  int ordersort;                // 1 if dump sort was set up by order
+
+  double curve_key(double *);
+
+  // extra outputs fed from the same pack, sort and gather
+
+  std::vector<class ExtxyzSink *> sinks;
+  int rowsinks;                 // # of serial sinks consuming packed rows
+  int parsinks;                 // # of parallel sinks
+  int textflag;                 // 0 if dump file gets no atom text
+  int frameflag;                // 1 if sinks have an open frame
+  double *sinkbuf;              // rows received from other procs for sinks
+  int maxsinkbuf;
+
+  class ExtxyzIndex *spatial;   // spatial index sidecar, nullptr if none
+
+  // frames of the dump file written by a background thread on proc 0
+
+  int asyncflag;                // 1 if dump file is written asynchronously
+  class ExtxyzWriter *writer;   // writer thread, nullptr if synchronous
+
+  // frames of the dump file staged in a node-local directory and drained
+  // to the dump file by a background thread on proc 0
+
+  std::string stagedir;         // staging directory, empty if none
+  bigint stagelimit;            // max bytes staged before the dump waits
+  class ExtxyzStage *stage;     // drain thread, nullptr if not staging
+
+  void write_bytes(const char *, size_t);
+  void put_bytes(const char *, size_t);
+
+  // text of the dump file compressed on proc 0 into independent zstd frames
+  // of one block each, blocks compressed concurrently by OpenMP threads and
+  // written in order; the file is a valid concatenated .zst stream
+
+  int zflag;                    // 1 if the dump compresses its file itself
+  int zlevel;                   // zstd level
+  bigint zblock;                // bytes of text per block
+  std::vector<char> ztext;      // text not yet compressed
+  std::vector<std::vector<char>> zout;    // compressed blocks
+  std::vector<ZSTD_CCtx_s *> zctx;        // zstd context per thread
+
+  void compress_blocks(int);
+
+  // frames of the dump file formatted and written by forked children of
+  // proc 0, which see the frame as a copy-on-write image of the parent
+
+  int forkmax;                  // max # of concurrent children, 0 = no fork
+  std::vector<int> children;    // pids of running children, oldest first
+  int forkfd;                   // read end of pipe the last child signals on
+  std::string forkhead;         // header of current frame
+  std::vector<double> forkrows; // packed rows of current frame
+
+  void fork_frame();
+  int reap_children(int);
+
+  // frames packed locally and written K at a time, with one gather,
+  // one sort and one write for all of them
+
+  struct BatchFrame {
+    double box[9];              // boxxlo ... boxyz of the frame
+    int nlocal;                 // # of my rows of the frame in batchrows
+  };
+
+  int nbatch;                   // # of frames per batch, 1 = no batching
+  std::vector<BatchFrame> batchframes;    // frames not yet written
+  std::vector<double> batchrows;          // my packed rows of these frames
+
+  void write_batch();
+  int batch_due();
+  int last_in_run(int);
+  void flush_batch();
+  void flush_pending();
+
+  // text of other procs pulled by proc 0 in chunks through a fixed window
+  // of receive buffers and written as each chunk arrives
+
+  bigint streamcap;             // max bytes of text buffers on proc 0, 0 = off
+  std::vector<char> streambuf;  // receive window on proc 0
+
+  int stream_lines(int, double *);
+
+  // time in write() held to a fraction of wall time: over budget, frames
+  // are skipped or written with a coarse line format
+
+  enum { NOBUDGET, SKIP, COARSE };
+
+  int budgetmode;               // NOBUDGET, SKIP or COARSE
+  double budget;                // max fraction of wall time spent in write()
+  double budgetstart;           // wall time of 1st frame, < 0 before it
+  double budgetlast;            // my time in write() for the previous frame
+  double budgettime;            // time in write() of all frames, max of all procs
+  int throttled;                // 1 if the current frame is over budget
+
+  int over_budget(double);
+
+  // frames written only when atoms moved far enough since the last written
+  // frame or too many steps passed; reference positions are unwrapped
+  // coordinates kept per atom by a FixStore, so they migrate with atoms
+
+  enum { NOTRIGGER, MAXDISP, RMSDISP };
+
+  int trigger;                  // NOTRIGGER, MAXDISP or RMSDISP
+  double threshold;             // displacement that triggers a frame
+  bigint triggerevery;          // max # of steps between frames, 0 = no max
+  bigint triggerlast;           // step of last written frame, -1 if none
+  char *id_fix;                 // ID of fix holding reference positions
+  class FixStore *fixref;
+
+  int trigger_due();
+  void trigger_reset();
+
+  class ExtxyzCounters *counters;   // hardware counters of phases, nullptr if off
+
   void init_style() override;
   void write_header(bigint) override;
   typedef void (DumpEXTXYZ::*FnPtrHeader)(bigint);
   FnPtrHeader header_choice;
   void header_binary(bigint);
   void header_binary_triclinic(bigint);
-  typedef void (DumpEXTXYZ::*FnPtrPack)(tagint *);
-  FnPtrPack pack_choice;    // ptr to pack functions
   void pack(tagint *);
-  void pack_triclinic(tagint *);
   int convert_string(int, double *) override;
   void write_data(int, double *) override;
   int modify_param(int, char **) override;
@@ -51,6 +194,55 @@ class DumpEXTXYZ : public Dump {
   FnPtrWrite write_choice;    // ptr to write data functions
   void write_string(int, double *);
   void write_lines(int, double *);
+  int format_lines(int, double *);
+  void gather_rows(int, double *);
+  void feed_rows(int, double *);
+  void open_frame(bigint, bigint);
+  void make_comment();
+  void write_parallel(int, double *);
+  void setup_frame(struct ExtxyzFrame &, bigint);
+
+  // line format compiled once per init_style() into a list of operations
+
+  enum { SPRINTF, PROGRAM };
+  enum { LITERAL, SPECIES, FLOAT, PRINTF, ID };
+
+  struct FormatOp;
+  typedef char *(*FnEmit)(char *, const FormatOp &, const double *);
+
+  struct FormatOp {
+    int kind;            // LITERAL, SPECIES, FLOAT, PRINTF or ID
+    FnEmit emit;         // emitter selected when the format is compiled
+    int col;             // column of packed buf consumed by a field
+    int width, prec;     // field width and precision, -1 if not given
+    int left;            // 1 if field is left-justified
+    char conv;           // printf conversion character of a field
+    char **names;        // species names for %s fields
+    std::string text;    // literal bytes or single-field printf spec
+  };
+
+  int engine;                       // SPRINTF or PROGRAM
+  std::vector<FormatOp> program;    // compiled line format
+  std::vector<FormatOp> coarse;     // coarse format of budget mode, swapped
+                                    // with program while over budget
+
+  void compile_format(const char *);
+  int sprintf_line(char *, const char *, const double *);
+
+  // differential check of the compiled format against sprintf of the line
+  // format on random and adversarial values, engine falls back to sprintf
+  // on a mismatch
+
+  int checkrows;                    // # of rows checked per init, 0 = no check
+
+  int check_engine(const char *);
+  void check_rows(std::vector<double> &);
+
+  static char *emit_literal(char *, const FormatOp &, const double *);
+  static char *emit_species(char *, const FormatOp &, const double *);
+  static char *emit_printf(char *, const FormatOp &, const double *);
+  static char *emit_id(char *, const FormatOp &, const double *);
+  template <char CONV> static char *emit_float(char *, const FormatOp &, const double *);
 };
 
 }    // namespace LAMMPS_NS
@@ -0,0 +1,170 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#include "extxyz_counters.h"
+
+#include "comm.h"
+#include "platform.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace LAMMPS_NS;
+
+#if defined(__linux__)
+static const uint64_t config[ExtxyzCounters::NCOUNTER] = {
+  PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+#endif
+
+static const char *phasenames[ExtxyzCounters::NPHASE] = {"pack","convert","write"};
+
+/* ----------------------------------------------------------------------
+   open the counter group of the calling thread, all or nothing
+------------------------------------------------------------------------- */
+
+ExtxyzCounters::ExtxyzCounters(LAMMPS *lmp) : Pointers(lmp)
+{
+  for (int k = 0; k < NCOUNTER; k++) fd[k] = -1;
+  for (int k = 0; k < NCOUNTER+2; k++) begin[k] = 0.0;
+  begintime = 0.0;
+  for (int iphase = 0; iphase < NPHASE; iphase++) {
+    for (int k = 0; k < NCOUNTER; k++) total[iphase][k] = 0.0;
+    seconds[iphase] = 0.0;
+  }
+  natoms = 0;
+
+#if defined(__linux__)
+  for (int k = 0; k < NCOUNTER; k++) {
+    struct perf_event_attr attr;
+    memset(&attr,0,sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config[k];
+    attr.disabled = (k == 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+      PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fd[k] = syscall(SYS_perf_event_open,&attr,0,-1,fd[0],0);
+    if (fd[k] < 0) {
+      why = fmt::format("perf_event_open: {} (see /proc/sys/kernel/perf_event_paranoid)",
+                        strerror(errno));
+      for (int m = 0; m < k; m++) close(fd[m]);
+      for (int m = 0; m < NCOUNTER; m++) fd[m] = -1;
+      return;
+    }
+  }
+
+  ioctl(fd[0],PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+  ioctl(fd[0],PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+#else
+  why = "perf_event_open is Linux only";
+#endif
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzCounters::~ExtxyzCounters()
+{
+#if defined(__linux__)
+  for (int k = 0; k < NCOUNTER; k++)
+    if (fd[k] >= 0) close(fd[k]);
+#endif
+}
+
+/* ----------------------------------------------------------------------
+   read the group into values[NCOUNTER], then enabled and running time
+   return 0 on failure
+------------------------------------------------------------------------- */
+
+int ExtxyzCounters::read_group(double *values)
+{
+#if defined(__linux__)
+  uint64_t data[3+NCOUNTER];
+  if (read(fd[0],data,sizeof(data)) != (ssize_t) sizeof(data)) return 0;
+  for (int k = 0; k < NCOUNTER; k++) values[k] = data[3+k];
+  values[NCOUNTER] = data[1];
+  values[NCOUNTER+1] = data[2];
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzCounters::start()
+{
+  if (!available()) return;
+  begintime = platform::walltime();
+  read_group(begin);
+}
+
+/* ----------------------------------------------------------------------
+   add the counts since start() to phase iphase, n atoms if pack
+   counts are scaled to the full time when the group was multiplexed
+------------------------------------------------------------------------- */
+
+void ExtxyzCounters::stop(int iphase, bigint n)
+{
+  if (!available()) return;
+
+  double end[NCOUNTER+2];
+  if (!read_group(end)) return;
+  seconds[iphase] += platform::walltime() - begintime;
+
+  double enabled = end[NCOUNTER] - begin[NCOUNTER];
+  double running = end[NCOUNTER+1] - begin[NCOUNTER+1];
+  double scale = (running > 0.0) ? enabled/running : 0.0;
+  for (int k = 0; k < NCOUNTER; k++) total[iphase][k] += scale * (end[k] - begin[k]);
+
+  natoms += n;
+}
+
+/* ----------------------------------------------------------------------
+   sums over all procs, time the max of all procs, logged by proc 0
+   misses are per dumped atom, i.e. per atom packed on any proc
+------------------------------------------------------------------------- */
+
+void ExtxyzCounters::summary(const char *id)
+{
+  double all[NPHASE][NCOUNTER], maxtime[NPHASE];
+  bigint allatoms;
+  MPI_Reduce(&total[0][0],&all[0][0],NPHASE*NCOUNTER,MPI_DOUBLE,MPI_SUM,0,world);
+  MPI_Reduce(seconds,maxtime,NPHASE,MPI_DOUBLE,MPI_MAX,0,world);
+  MPI_Reduce(&natoms,&allatoms,1,MPI_LMP_BIGINT,MPI_SUM,0,world);
+  if (comm->me != 0) return;
+
+  std::string mesg = fmt::format("Dump {} hardware counters, {} atoms dumped, all procs:\n"
+                                 "  phase        time(s)       cycles instructions   IPC"
+                                 "  cache-miss/atom  branch-miss/atom\n",id,allatoms);
+  double peratom = (allatoms > 0) ? 1.0/allatoms : 0.0;
+  for (int iphase = 0; iphase < NPHASE; iphase++) {
+    const double *c = all[iphase];
+    double ipc = (c[CYCLES] > 0.0) ? c[INSTRUCTIONS]/c[CYCLES] : 0.0;
+    mesg += fmt::format("  {:<8} {:>11.4g} {:>12.4g} {:>12.4g} {:>5.2f} {:>16.3f} {:>17.3f}\n",
+                        phasenames[iphase],maxtime[iphase],c[CYCLES],c[INSTRUCTIONS],ipc,
+                        c[CACHEMISSES]*peratom,c[BRANCHMISSES]*peratom);
+  }
+  utils::logmesg(lmp,mesg);
+}
@@ -0,0 +1,62 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_COUNTERS_H
+#define LMP_EXTXYZ_COUNTERS_H
+
+#include "pointers.h"
+
+#include <string>
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   hardware counters of the thread that creates them, read around the
+   phases of a dump extxyz with Linux perf_event_open(2)
+   cycles, instructions, cache misses and branch misses are one group,
+   scheduled together; values are scaled by enabled/running time when
+   the kernel multiplexes counters
+   user space only, so perf_event_paranoid <= 2 suffices
+------------------------------------------------------------------------- */
+
+class ExtxyzCounters : protected Pointers {
+ public:
+  enum { PACK, CONVERT, WRITE, NPHASE };
+  enum { CYCLES, INSTRUCTIONS, CACHEMISSES, BRANCHMISSES, NCOUNTER };
+
+  ExtxyzCounters(class LAMMPS *);
+  ~ExtxyzCounters() override;
+
+  int available() const { return fd[0] >= 0; }
+  const std::string &reason() const { return why; }
+  void start();
+  void stop(int, bigint = 0);
+  void summary(const char *);
+
+ private:
+  int fd[NCOUNTER];              // group leader 1st, -1 if not open
+  std::string why;               // why counters are unavailable
+
+  double begin[NCOUNTER+2];      // values at start(), then enabled, running time
+  double begintime;
+
+  double total[NPHASE][NCOUNTER];
+  double seconds[NPHASE];
+  bigint natoms;                 // # of atoms packed
+
+  int read_group(double *);
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
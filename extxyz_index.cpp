@@ -0,0 +1,215 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#include "extxyz_index.h"
+
+#include "comm.h"
+#include "error.h"
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace LAMMPS_NS;
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzIndex::ExtxyzIndex(LAMMPS *lmp, const char *file, int n) :
+  Pointers(lmp), fp(nullptr), ncell(n)
+{
+  filename = utils::strdup(file);
+  offset = data = 0;
+  nlocal = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzIndex::~ExtxyzIndex()
+{
+  if (fp) fclose(fp);
+  delete[] filename;
+}
+
+/* ----------------------------------------------------------------------
+   open sidecar file on proc 0, once
+------------------------------------------------------------------------- */
+
+void ExtxyzIndex::open()
+{
+  if (fp || comm->me != 0) return;
+
+  fp = fopen(filename,"w");
+  if (fp == nullptr)
+    error->one(FLERR,"Cannot open dump extxyz index file {}: {}",filename,utils::getsyserror());
+}
+
+/* ----------------------------------------------------------------------
+   file offsets of the frame and of its 1st atom line, set on proc 0
+------------------------------------------------------------------------- */
+
+void ExtxyzIndex::mark(bigint frame, bigint atoms)
+{
+  offset = frame;
+  data = atoms;
+}
+
+/* ----------------------------------------------------------------------
+   start indexing my rows of a frame, region is origin and edge lengths
+   of the box the cells divide, in the coordinates of the packed rows
+------------------------------------------------------------------------- */
+
+void ExtxyzIndex::begin_local(const double *origin, const double *edges)
+{
+  for (int dim = 0; dim < 3; dim++) {
+    lo[dim] = origin[dim];
+    len[dim] = edges[dim];
+    bounds[dim] = DBL_MAX;
+    bounds[3+dim] = -DBL_MAX;
+  }
+  runs.clear();
+  nlocal = 0;
+}
+
+/* ----------------------------------------------------------------------
+   add my next row in file order, nbytes = length of its line
+------------------------------------------------------------------------- */
+
+void ExtxyzIndex::add(const double *one, int nbytes)
+{
+  bigint cell = 0;
+  for (int dim = 0; dim < 3; dim++) {
+    double x = one[2+dim];
+    bounds[dim] = MIN(bounds[dim],x);
+    bounds[3+dim] = MAX(bounds[3+dim],x);
+
+    int i = static_cast<int>((x - lo[dim]) / len[dim] * ncell);
+    i = MAX(0,MIN(ncell-1,i));
+    cell = cell*ncell + i;
+  }
+
+  if (!runs.empty() && runs.back().cell == cell) {
+    runs.back().count++;
+    runs.back().nbytes += nbytes;
+  } else runs.push_back({cell,1,nbytes});
+  nlocal++;
+}
+
+/* ----------------------------------------------------------------------
+   collect runs and bounds of all procs on proc 0 and write the frame
+   procs are in file order, as in the gather of Dump::write()
+------------------------------------------------------------------------- */
+
+void ExtxyzIndex::write(bigint ntimestep, bigint natoms)
+{
+  int me = comm->me;
+  int nprocs = comm->nprocs;
+
+  int nrun = runs.size();
+  std::vector<int> counts(nprocs), displs(nprocs);
+  MPI_Gather(&nrun,1,MPI_INT,counts.data(),1,MPI_INT,0,world);
+
+  std::vector<bigint> send(3*nrun);
+  for (int i = 0; i < nrun; i++) {
+    send[3*i] = runs[i].cell;
+    send[3*i+1] = runs[i].count;
+    send[3*i+2] = runs[i].nbytes;
+  }
+
+  std::vector<bigint> recv;
+  int total = 0;
+  if (me == 0) {
+    for (int iproc = 0; iproc < nprocs; iproc++) {
+      counts[iproc] *= 3;
+      displs[iproc] = total;
+      total += counts[iproc];
+    }
+    recv.resize(total);
+  }
+  MPI_Gatherv(send.data(),3*nrun,MPI_LMP_BIGINT,recv.data(),counts.data(),displs.data(),
+              MPI_LMP_BIGINT,0,world);
+
+  double info[7] = {(double) nlocal,bounds[0],bounds[1],bounds[2],bounds[3],bounds[4],bounds[5]};
+  std::vector<double> allinfo(me == 0 ? 7*nprocs : 0);
+  MPI_Gather(info,7,MPI_DOUBLE,allinfo.data(),7,MPI_DOUBLE,0,world);
+
+  if (me != 0) return;
+
+  // runs in file order with atom index and byte range,
+  // merged across proc boundaries, then grouped by cell
+
+  struct Range {
+    bigint cell, first, count, begin, end;
+  };
+  std::vector<Range> ranges;
+  bigint first = 0;
+  bigint byte = data;
+  for (int i = 0; i < total; i += 3) {
+    bigint cell = recv[i], count = recv[i+1], nbytes = recv[i+2];
+    if (!ranges.empty() && ranges.back().cell == cell) {
+      ranges.back().count += count;
+      ranges.back().end += nbytes;
+    } else ranges.push_back({cell,first,count,byte,byte+nbytes});
+    first += count;
+    byte += nbytes;
+  }
+  std::stable_sort(ranges.begin(),ranges.end(),
+                   [](const Range &a, const Range &b) { return a.cell < b.cell; });
+
+  double box[6] = {DBL_MAX,DBL_MAX,DBL_MAX,-DBL_MAX,-DBL_MAX,-DBL_MAX};
+  std::string ranks;
+  first = 0;
+  for (int iproc = 0; iproc < nprocs; iproc++) {
+    const double *one = &allinfo[7*iproc];
+    bigint count = static_cast<bigint>(one[0]);
+    double b[6] = {0.0,0.0,0.0,0.0,0.0,0.0};
+    if (count)
+      for (int k = 0; k < 6; k++) b[k] = one[1+k];
+    for (int dim = 0; dim < 3 && count; dim++) {
+      box[dim] = MIN(box[dim],b[dim]);
+      box[3+dim] = MAX(box[3+dim],b[3+dim]);
+    }
+    if (iproc) ranks += ",";
+    ranks += fmt::format("[{},{},{},{},{},{},{},{}]",first,count,b[0],b[1],b[2],b[3],b[4],b[5]);
+    first += count;
+  }
+  if (first == 0)
+    for (int k = 0; k < 6; k++) box[k] = 0.0;
+
+  fmt::print(fp,"{{\"step\":{},\"natoms\":{},\"offset\":{},\"data\":{},\"cells\":{},"
+             "\"box\":[{},{},{},{},{},{}],\"ranks\":[{}],\"runs\":[",ntimestep,natoms,offset,
+             data,ncell,box[0],box[1],box[2],box[3],box[4],box[5],ranks);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    const Range &r = ranges[i];
+    fmt::print(fp,"{}[{},{},{},{},{}]",i ? "," : "",r.cell,r.first,r.count,r.begin,r.end);
+  }
+  fputs("]}\n",fp);
+  fflush(fp);
+}
+
+/* ----------------------------------------------------------------------
+   record a snapshot that was not written, called on proc 0
+------------------------------------------------------------------------- */
+
+void ExtxyzIndex::skip(bigint ntimestep)
+{
+  if (!fp) return;
+  fmt::print(fp,"{{\"step\":{},\"skipped\":true}}\n",ntimestep);
+  fflush(fp);
+}
+
+/* ---------------------------------------------------------------------- */
+
+double ExtxyzIndex::memory_usage()
+{
+  return (double) runs.capacity() * sizeof(Run);
+}
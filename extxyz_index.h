@@ -0,0 +1,72 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_INDEX_H
+#define LMP_EXTXYZ_INDEX_H
+
+#include "pointers.h"
+
+#include <vector>
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   spatial index of the frames of a dump extxyz file, one JSON line per
+   frame in a sidecar file:
+     {"step":S,"natoms":N,"offset":O,"data":D,"cells":C,
+      "box":[xlo,ylo,zlo,xhi,yhi,zhi],
+      "ranks":[[first,count,xlo,ylo,zlo,xhi,yhi,zhi],...],
+      "runs":[[cell,first,count,begin,end],...]}
+   offset = byte offset of the frame in the dump file, data = of its 1st
+   atom line; the box (the bounding box of a triclinic cell) is divided
+   into C^3 cells in the coordinates of the file, cell = (ix*C+iy)*C+iz;
+   a run is a block of consecutive atom lines in one cell: atoms
+   first..first+count-1 of the frame at bytes [begin,end) of the file,
+   runs are listed by cell, then by position in the file
+   ranks = slice of the frame written by each proc and its bounding box
+   a snapshot left out of the dump file by dump_modify budget is listed as
+     {"step":S,"skipped":true}
+------------------------------------------------------------------------- */
+
+class ExtxyzIndex : protected Pointers {
+ public:
+  ExtxyzIndex(class LAMMPS *, const char *, int);
+  ~ExtxyzIndex() override;
+
+  void open();
+  void mark(bigint, bigint);
+  void begin_local(const double *, const double *);
+  void add(const double *, int);
+  void write(bigint, bigint);
+  void skip(bigint);
+  double memory_usage();
+
+ private:
+  char *filename;
+  FILE *fp;
+  int ncell;                   // # of cells per dimension
+  double lo[3], len[3];        // region divided into cells
+  bigint offset, data;         // file offsets of current frame
+
+  struct Run {
+    bigint cell, count, nbytes;
+  };
+
+  std::vector<Run> runs;       // runs of my rows, all runs on proc 0
+  bigint nlocal;               // # of my rows
+  double bounds[6];            // bounding box of my rows
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
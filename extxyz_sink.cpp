@@ -0,0 +1,820 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#include "extxyz_sink.h"
+
+#include "comm.h"
+#include "dump_extxyz.h"
+#include "error.h"
+#include "extxyz_trace.h"
+#include "platform.h"
+
+#include <cmath>
+#include <cstring>
+
+#ifdef LAMMPS_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace LAMMPS_NS;
+
+// leading bytes of an encoded column: delta flag, coder, int64 raw size
+
+static constexpr int CODEC_HEADER = 2 + sizeof(int64_t);
+enum { ZERORLE, ZSTD };
+enum { NOCODEC, SHUFFLE, LOSSY };
+
+// coders tried by level auto, lightest first: zero-run-length only,
+// then zstd levels; negative zstd levels are its fast mode
+
+static constexpr int NOZSTD = -1000;
+static constexpr int LADDER[] = {NOZSTD, -5, -1, 1, 3, 6, 9, 12, 15, 19};
+static constexpr int NRUNG = sizeof(LADDER) / sizeof(int);
+static constexpr double BALANCE = 1.25;       // imbalance of encode/write that moves
+static constexpr double WORSE = 1.10;         // cost increase that undoes a move
+static constexpr int HOLD = 8;                // frames to wait after an undo
+
+static std::string level_name(int level)
+{
+  if (level == NOZSTD) return "rle";
+  return fmt::format("zstd{}",level);
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSink::ExtxyzSink(LAMMPS *lmp, DumpEXTXYZ *ptr, const char *file) :
+  Pointers(lmp), dump(ptr)
+{
+  filename = utils::strdup(file);
+  rowflag = 0;
+  parallel = 0;
+  subsample = 1;
+  hashflag = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSink::~ExtxyzSink()
+{
+  delete[] filename;
+}
+
+/* ----------------------------------------------------------------------
+   process one sink keyword, return # of args consumed, 0 if unknown
+------------------------------------------------------------------------- */
+
+int ExtxyzSink::modify_param(int narg, char **arg)
+{
+  if (strcmp(arg[0],"subsample") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    subsample = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (subsample < 1) error->all(FLERR,"Illegal dump_modify sink subsample: {}",arg[1]);
+    return 2;
+  }
+
+  if (strcmp(arg[0],"select") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    if (strcmp(arg[1],"modulo") == 0) hashflag = 0;
+    else if (strcmp(arg[1],"hash") == 0) hashflag = 1;
+    else error->all(FLERR,"Illegal dump_modify sink select: {}",arg[1]);
+    return 2;
+  }
+
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   # of my rows kept by subsampling, for parallel sinks
+   offset = global index of my 1st kept row, ntotal = kept rows of all procs
+   collective if subsampling, else offset is left as passed in
+------------------------------------------------------------------------- */
+
+int ExtxyzSink::select_local(const ExtxyzFrame &f, int n, const double *rows,
+                             bigint &offset, bigint &ntotal)
+{
+  int nsel = 0;
+  for (int i = 0; i < n; i++)
+    if (selected(&rows[i*f.size_one])) nsel++;
+
+  if (subsample == 1) {
+    ntotal = f.natoms;
+    return nsel;
+  }
+
+  bigint bsel = nsel;
+  offset = ntotal = 0;
+  MPI_Exscan(&bsel,&offset,1,MPI_LMP_BIGINT,MPI_SUM,world);
+  if (comm->me == 0) offset = 0;
+  MPI_Allreduce(&bsel,&ntotal,1,MPI_LMP_BIGINT,MPI_SUM,world);
+  return nsel;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkText::ExtxyzSinkText(LAMMPS *lmp, DumpEXTXYZ *ptr, const char *file) :
+  ExtxyzSink(lmp,ptr,file), fp(nullptr)
+{
+  compressed = 0;
+  nframe = 0;
+  offset = -1;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkText::~ExtxyzSinkText()
+{
+  if (fp) {
+    if (compressed) platform::pclose(fp);
+    else fclose(fp);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   the full frame is copied from the dump's own text,
+   a subsampled frame is formatted here from packed rows
+------------------------------------------------------------------------- */
+
+int ExtxyzSinkText::modify_param(int narg, char **arg)
+{
+  int n = ExtxyzSink::modify_param(narg,arg);
+  rowflag = (subsample > 1);
+  return n;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkText::init(int, char **)
+{
+  if (fp) return;
+
+  if (platform::has_compress_extension(filename)) {
+    compressed = 1;
+    fp = platform::compressed_write(filename);
+  } else fp = fopen(filename,"w");
+
+  if (fp == nullptr)
+    error->one(FLERR,"Cannot open dump extxyz sink file {}: {}",filename,utils::getsyserror());
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkText::begin_frame(const ExtxyzFrame &f)
+{
+  frame = f;
+  offset = compressed ? -1 : platform::ftell(fp);
+  if (!rowflag) {
+    fmt::print(fp,"{}\n{}\n",frame.natoms,frame.comment);
+    return;
+  }
+
+  // atom count of a subsampled frame is known only at its end
+
+  nframe = 0;
+  text.clear();
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkText::write_text(const char *str, int n)
+{
+  fwrite(str,sizeof(char),n,fp);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkText::write_rows(int n, const double *rows)
+{
+  for (int i = 0; i < n; i++) {
+    const double *one = &rows[i*frame.size_one];
+    if (!selected(one)) continue;
+
+    size_t offset = text.size();
+    text.resize(offset + dump->maxline);
+    int len = dump->format_line(&text[offset],one);
+    text.resize(offset + len);
+    nframe++;
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkText::end_frame()
+{
+  if (rowflag) {
+    fmt::print(fp,"{}\n{}\n",nframe,frame.comment);
+    fwrite(text.data(),sizeof(char),text.size(),fp);
+  }
+  fflush(fp);
+}
+
+/* ---------------------------------------------------------------------- */
+
+double ExtxyzSinkText::memory_usage()
+{
+  return (double) text.capacity();
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkLatest::ExtxyzSinkLatest(LAMMPS *lmp, DumpEXTXYZ *ptr, const char *file) :
+  ExtxyzSinkText(lmp,ptr,file)
+{
+  every = 1;
+  nseen = 0;
+  active = 0;
+  tmpname = std::string(filename) + ".tmp";
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ExtxyzSinkLatest::modify_param(int narg, char **arg)
+{
+  if (strcmp(arg[0],"every") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    every = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (every < 1) error->all(FLERR,"Illegal dump_modify sink every: {}",arg[1]);
+    return 2;
+  }
+
+  return ExtxyzSinkText::modify_param(narg,arg);
+}
+
+/* ----------------------------------------------------------------------
+   file is opened per frame, a compressed file could not be renamed whole
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkLatest::init(int, char **)
+{
+  if (platform::has_compress_extension(filename))
+    error->one(FLERR,"Dump extxyz sink latest cannot write compressed file {}",filename);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkLatest::begin_frame(const ExtxyzFrame &f)
+{
+  active = (nseen++ % every == 0);
+  if (!active) return;
+
+  fp = fopen(tmpname.c_str(),"w");
+  if (fp == nullptr)
+    error->one(FLERR,"Cannot open dump extxyz sink file {}: {}",tmpname,utils::getsyserror());
+  ExtxyzSinkText::begin_frame(f);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkLatest::write_text(const char *str, int n)
+{
+  if (active) ExtxyzSinkText::write_text(str,n);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkLatest::write_rows(int n, const double *rows)
+{
+  if (active) ExtxyzSinkText::write_rows(n,rows);
+}
+
+/* ----------------------------------------------------------------------
+   complete frame replaces the previous one in a single rename
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkLatest::end_frame()
+{
+  if (!active) return;
+  active = 0;
+
+  ExtxyzSinkText::end_frame();
+  int flag = ferror(fp);
+  flag |= fclose(fp);
+  fp = nullptr;
+  if (flag) error->one(FLERR,"Error writing dump extxyz sink file {}",tmpname);
+
+#if defined(_WIN32)
+  platform::unlink(filename);
+#endif
+  if (rename(tmpname.c_str(),filename) != 0)
+    error->one(FLERR,"Cannot rename dump extxyz sink file {} to {}: {}",tmpname,filename,
+               utils::getsyserror());
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkLOD::ExtxyzSinkLOD(LAMMPS *lmp, DumpEXTXYZ *ptr, const char *base) :
+  ExtxyzSink(lmp,ptr,base), fp(nullptr)
+{
+  rowflag = 1;
+  nlevel = 2;
+  factor = 8;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkLOD::~ExtxyzSinkLOD()
+{
+  for (auto &level : levels) delete level;
+  if (fp) fclose(fp);
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ExtxyzSinkLOD::modify_param(int narg, char **arg)
+{
+  if (strcmp(arg[0],"levels") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    nlevel = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (nlevel < 1) error->all(FLERR,"Illegal dump_modify sink levels: {}",arg[1]);
+    return 2;
+  }
+
+  if (strcmp(arg[0],"factor") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    factor = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (factor < 2) error->all(FLERR,"Illegal dump_modify sink factor: {}",arg[1]);
+    return 2;
+  }
+
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   create one subsampled text sink per level and the level index
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkLOD::init(int ntypes, char **typenames)
+{
+  if (fp) return;
+
+  bigint every = 1;
+  for (int ilevel = 1; ilevel <= nlevel; ilevel++) {
+    every *= factor;
+    if (every > MAXSMALLINT) error->one(FLERR,"Dump extxyz sink lod has too many levels");
+
+    auto level = new ExtxyzSinkText(lmp,dump,fmt::format("{}.lod{}.xyz",filename,ilevel).c_str());
+    std::string keep = std::to_string(every);
+    char *args[4] = {(char *) "subsample",(char *) keep.c_str(),(char *) "select",(char *) "hash"};
+    level->modify_param(2,&args[0]);
+    level->modify_param(2,&args[2]);
+    level->init(ntypes,typenames);
+    levels.push_back(level);
+  }
+
+  std::string indexfile = fmt::format("{}.lod.json",filename);
+  fp = fopen(indexfile.c_str(),"w");
+  if (fp == nullptr)
+    error->one(FLERR,"Cannot open dump extxyz sink file {}: {}",indexfile,utils::getsyserror());
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkLOD::begin_frame(const ExtxyzFrame &f)
+{
+  frame = f;
+  for (auto &level : levels) level->begin_frame(f);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkLOD::write_rows(int n, const double *rows)
+{
+  for (auto &level : levels) level->write_rows(n,rows);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkLOD::end_frame()
+{
+  fmt::print(fp,"{{\"step\":{},\"levels\":[[1,{},{}]",frame.ntimestep,frame.natoms,frame.offset);
+  bigint every = 1;
+  for (auto &level : levels) {
+    level->end_frame();
+    every *= factor;
+    fmt::print(fp,",[{},{},{}]",every,level->frame_atoms(),level->frame_offset());
+  }
+  fputs("]}\n",fp);
+  fflush(fp);
+}
+
+/* ---------------------------------------------------------------------- */
+
+double ExtxyzSinkLOD::memory_usage()
+{
+  double bytes = 0.0;
+  for (auto &level : levels) bytes += level->memory_usage();
+  return bytes;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkBinary::ExtxyzSinkBinary(LAMMPS *lmp, DumpEXTXYZ *ptr, const char *file) :
+  ExtxyzSink(lmp,ptr,file), fp(nullptr)
+{
+  rowflag = 1;
+  nframe = 0;
+  idcolumn = 0;
+  codec = NOCODEC;
+  level = 1;
+  adaptflag = 0;
+  rung = lastrung = 3;
+  hold = 0;
+  lastcost = 0.0;
+  encodetime = writetime = 0.0;
+  nchange = 0;
+  tolerance = 0.0;
+  rawbytes = filebytes = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkBinary::~ExtxyzSinkBinary()
+{
+  if (fp) fclose(fp);
+
+  // timing summary of level auto
+
+  if (!adaptflag || rungframes.empty()) return;
+  std::string mesg = fmt::format("Dump extxyz sink {} level auto: encode {:.4g} s, write {:.4g} s, "
+                                 "{} level changes, frames per level:",filename,encodetime,
+                                 writetime,nchange);
+  for (int i = 0; i < NRUNG; i++)
+    if (rungframes[i]) mesg += fmt::format(" {} {}",level_name(LADDER[i]),rungframes[i]);
+  utils::logmesg(lmp,mesg + "\n");
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ExtxyzSinkBinary::modify_param(int narg, char **arg)
+{
+  if (strcmp(arg[0],"codec") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    if (strcmp(arg[1],"none") == 0) codec = NOCODEC;
+    else if (strcmp(arg[1],"shuffle") == 0) codec = SHUFFLE;
+    else if (strcmp(arg[1],"lossy") == 0) {
+      if (narg < 3) error->all(FLERR,"Illegal dump_modify sink command");
+      codec = LOSSY;
+      tolerance = utils::numeric(FLERR,arg[2],false,lmp);
+      if (tolerance <= 0.0) error->all(FLERR,"Illegal dump_modify sink codec lossy: {}",arg[2]);
+      return 3;
+    } else error->all(FLERR,"Illegal dump_modify sink codec: {}",arg[1]);
+    return 2;
+  }
+
+  if (strcmp(arg[0],"level") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    if (strcmp(arg[1],"auto") == 0) {
+      adaptflag = 1;
+      level = LADDER[rung];
+    } else {
+      adaptflag = 0;
+      level = utils::inumeric(FLERR,arg[1],false,lmp);
+#ifdef LAMMPS_ZSTD
+      if (level < ZSTD_minCLevel() || level > ZSTD_maxCLevel())
+        error->all(FLERR,"Illegal dump_modify sink level {}, zstd levels are {} to {}",level,
+                   ZSTD_minCLevel(),ZSTD_maxCLevel());
+#endif
+    }
+    return 2;
+  }
+
+  return ExtxyzSink::modify_param(narg,arg);
+}
+
+/* ----------------------------------------------------------------------
+   open file and write the species table once
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkBinary::init(int ntypes, char **typenames)
+{
+  if (fp) return;
+
+  fp = fopen(filename,"wb");
+  if (fp == nullptr)
+    error->one(FLERR,"Cannot open dump extxyz sink file {}: {}",filename,utils::getsyserror());
+
+  fwrite("EXTXYZB1",sizeof(char),8,fp);
+  fwrite(&ntypes,sizeof(int),1,fp);
+  for (int itype = 1; itype <= ntypes; itype++) {
+    int len = strlen(typenames[itype]);
+    fwrite(&len,sizeof(int),1,fp);
+    fwrite(typenames[itype],sizeof(char),len,fp);
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkBinary::begin_frame(const ExtxyzFrame &f)
+{
+  frame = f;
+  nframe = 0;
+  types.clear();
+  ids.clear();
+  columns.resize(frame.nvalue);
+  for (auto &column : columns) column.clear();
+}
+
+/* ----------------------------------------------------------------------
+   transpose rows into columns, whole frame is written at its end
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkBinary::write_rows(int n, const double *rows)
+{
+  for (int i = 0; i < n; i++) {
+    const double *one = &rows[i*frame.size_one];
+    if (!selected(one)) continue;
+
+    types.push_back(static_cast<int>(one[1]));
+    for (int k = 0; k < frame.nvalue; k++) columns[k].push_back(one[2+k]);
+    if (frame.idflag || idcolumn) ids.push_back(static_cast<int64_t>(one[0]));
+    nframe++;
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkBinary::end_frame()
+{
+  static const char *names[9] = {"x","y","z","vx","vy","vz","fx","fy","fz"};
+
+  int ncol = 1 + frame.nvalue + frame.idflag;
+  fwrite(&frame.ntimestep,sizeof(bigint),1,fp);
+  fwrite(&nframe,sizeof(bigint),1,fp);
+  fwrite(frame.lattice,sizeof(double),9,fp);
+  fwrite(&ncol,sizeof(int),1,fp);
+
+  write_column("type",0,types.data(),nframe);
+
+  // columns are independent, encode them concurrently
+  // positions (1st 3 columns) are quantized with codec lossy
+
+  double time0 = platform::walltime();
+  if (codec != NOCODEC) {
+    previous.resize(frame.nvalue);
+    qprevious.resize(frame.nvalue);
+    encoded.resize(frame.nvalue);
+    kinds.resize(frame.nvalue);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int k = 0; k < frame.nvalue; k++) {
+      double start = dump->trace ? dump->trace->now() : 0.0;
+      kinds[k] = 2;
+      if (codec == LOSSY && k < 3 && quantize_column(k)) kinds[k] = 3;
+      else encode_column(k);
+      if (dump->trace)
+        dump->trace->add("compress",start,dump->trace->now(),dump->trace->frame());
+    }
+  }
+
+  double time1 = platform::walltime();
+
+  bigint nbytes = 0;
+  int k = 0;
+  for (int igroup = 0; igroup < 3; igroup++) {
+    if (igroup == 1 && !frame.vflag) continue;
+    if (igroup == 2 && !frame.fflag) continue;
+    for (int dim = 0; dim < 3; dim++, k++) {
+      if (codec != NOCODEC) {
+        write_column(names[3*igroup+dim],kinds[k],encoded[k].data(),encoded[k].size());
+        nbytes += encoded[k].size();
+      } else write_column(names[3*igroup+dim],1,columns[k].data(),nframe);
+    }
+  }
+  if (frame.idflag) write_column("id",4,ids.data(),nframe);
+  fflush(fp);
+  double time2 = platform::walltime();
+
+  if (codec == NOCODEC) return;
+
+  // current columns are the reference of the next frame, as a decoder
+  // sees them: a quantized column is replaced by its values q*step
+
+  const double step = 2.0 * tolerance;
+  for (k = 0; k < frame.nvalue; k++) {
+    if (kinds[k] == 3) {
+      std::vector<double> &column = columns[k];
+      const std::vector<int64_t> &q = qprevious[k];
+      for (size_t i = 0; i < column.size(); i++) column[i] = q[i] * step;
+    } else qprevious[k].clear();
+    previous[k].swap(columns[k]);
+  }
+
+  bigint nraw = nframe * frame.nvalue * sizeof(double);
+  rawbytes += nraw;
+  filebytes += nbytes;
+  if (nbytes)
+    utils::logmesg(lmp,"Dump extxyz sink {} step {}: compression ratio {:.2f} (run {:.2f})\n",
+                   filename,frame.ntimestep,(double) nraw/nbytes,(double) rawbytes/filebytes);
+
+  if (adaptflag) adapt_level(time1-time0,time2-time1,nraw);
+}
+
+/* ----------------------------------------------------------------------
+   choose the coder of the next frame from encode and write time of this
+   frame, one rung of the ladder at a time
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkBinary::adapt_level(double tencode, double twrite, bigint nraw)
+{
+  if (rungframes.empty()) rungframes.assign(NRUNG,0);
+  rungframes[rung]++;
+  encodetime += tencode;
+  writetime += twrite;
+  if (nraw == 0) return;
+
+  double cost = (tencode + twrite) / nraw;
+  int next = rung;
+
+  if (hold > 0) hold--;
+  else if (lastcost > 0.0 && cost > WORSE*lastcost && rung != lastrung) {
+    next = lastrung;
+    hold = HOLD;
+  } else if (tencode > BALANCE*twrite && rung > 0) next = rung - 1;
+  else if (twrite > BALANCE*tencode && rung < NRUNG-1) next = rung + 1;
+
+  lastrung = rung;
+  lastcost = cost;
+  if (next == rung) return;
+
+  utils::logmesg(lmp,"Dump extxyz sink {} step {}: encode {:.3g} s, write {:.3g} s, "
+                 "level {} -> {}\n",filename,frame.ntimestep,tencode,twrite,
+                 level_name(LADDER[rung]),level_name(LADDER[next]));
+  rung = next;
+  level = LADDER[rung];
+  nchange++;
+}
+
+/* ----------------------------------------------------------------------
+   append bytes of in as zero-run-length code to out
+------------------------------------------------------------------------- */
+
+static void zero_rle(const unsigned char *in, size_t n, std::vector<char> &out)
+{
+  size_t i = 0;
+  while (i < n) {
+    size_t len = 0;
+    if (in[i] == 0) {
+      while (i+len < n && len < 128 && in[i+len] == 0) len++;
+      out.push_back(static_cast<char>(127+len));
+    } else {
+      // a literal run ends before the next pair of zero bytes
+
+      while (i+len < n && len < 128 && !(in[i+len] == 0 && i+len+1 < n && in[i+len+1] == 0))
+        len++;
+      out.push_back(static_cast<char>(len-1));
+      out.insert(out.end(),in+i,in+i+len);
+    }
+    i += len;
+  }
+}
+
+/* ----------------------------------------------------------------------
+   XOR column k with the previous frame, transpose its byte planes and
+   entropy code it into encoded[k], layout in extxyz_sink.h
+   called concurrently for different k, so no error calls here
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkBinary::encode_column(int k)
+{
+  const std::vector<double> &column = columns[k];
+  const std::vector<double> &prev = previous[k];
+  const size_t n = column.size();
+  const int64_t nbytes = n * sizeof(double);
+  const int delta = (n > 0) && (prev.size() == n);
+
+  std::vector<unsigned char> planes(nbytes);
+  unsigned char *plane = planes.data();
+  for (size_t i = 0; i < n; i++) {
+    uint64_t bits, ref = 0;
+    memcpy(&bits,&column[i],sizeof(bits));
+    if (delta) memcpy(&ref,&prev[i],sizeof(ref));
+    bits ^= ref;
+    for (int b = 0; b < 8; b++) plane[b*n+i] = static_cast<unsigned char>(bits >> 8*b);
+  }
+
+  std::vector<char> &out = encoded[k];
+  out.clear();
+  entropy_code(out,delta,plane,nbytes,level);
+}
+
+/* ----------------------------------------------------------------------
+   quantize position column k to integer multiples of 2*tolerance,
+   predict each value from the previous frame (or the previous atom)
+   and code zigzag varints of the residuals into encoded[k]
+   return 0 if a value cannot meet the bound (inf, nan, huge), the
+   column is then encoded losslessly
+------------------------------------------------------------------------- */
+
+int ExtxyzSinkBinary::quantize_column(int k)
+{
+  const std::vector<double> &column = columns[k];
+  std::vector<int64_t> &qprev = qprevious[k];
+  const size_t n = column.size();
+  const double step = 2.0 * tolerance;
+  const int delta = (n > 0) && (qprev.size() == n);
+
+  std::vector<int64_t> q(n);
+  for (size_t i = 0; i < n; i++) {
+    double scaled = column[i] / step;
+    if (!(fabs(scaled) < 4.0e15)) return 0;
+    q[i] = static_cast<int64_t>(llround(scaled));
+    if (!(fabs(column[i] - q[i]*step) <= tolerance)) return 0;
+  }
+
+  std::vector<unsigned char> varints;
+  varints.reserve(2*n);
+  int64_t last = 0;
+  for (size_t i = 0; i < n; i++) {
+    int64_t r = q[i] - (delta ? qprev[i] : last);
+    uint64_t z = (static_cast<uint64_t>(r) << 1) ^ static_cast<uint64_t>(r >> 63);
+    while (z >= 0x80) {
+      varints.push_back(static_cast<unsigned char>(z | 0x80));
+      z >>= 7;
+    }
+    varints.push_back(static_cast<unsigned char>(z));
+    last = q[i];
+  }
+
+  std::vector<char> &out = encoded[k];
+  out.resize(sizeof(double));
+  memcpy(out.data(),&step,sizeof(double));
+  entropy_code(out,delta,varints.data(),varints.size(),level);
+  qprev.swap(q);
+  return 1;
+}
+
+/* ----------------------------------------------------------------------
+   append delta flag, coder, raw size and coded bytes of data to out
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkBinary::entropy_code(std::vector<char> &out, int delta, const unsigned char *data,
+                                    int64_t nbytes, int level)
+{
+  size_t header = out.size();
+  out.resize(header + CODEC_HEADER);
+  out[header] = static_cast<char>(delta);
+  out[header+1] = ZERORLE;
+  memcpy(&out[header+2],&nbytes,sizeof(nbytes));
+
+#ifdef LAMMPS_ZSTD
+  if (level == NOZSTD) {
+    zero_rle(data,nbytes,out);
+    return;
+  }
+  size_t bound = ZSTD_compressBound(nbytes);
+  out.resize(header + CODEC_HEADER + bound);
+  size_t m = ZSTD_compress(&out[header+CODEC_HEADER],bound,data,nbytes,level);
+  if (!ZSTD_isError(m)) {
+    out[header+1] = ZSTD;
+    out.resize(header + CODEC_HEADER + m);
+    return;
+  }
+  out.resize(header + CODEC_HEADER);
+#endif
+
+  zero_rle(data,nbytes,out);
+}
+
+/* ----------------------------------------------------------------------
+   write one column record, kind 0 = int32, 1 = float64, 4 = int64,
+   2,3 = encoded column with n = # of bytes
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkBinary::write_column(const char *name, int kind, const void *data, bigint n)
+{
+  char label[8] = {0};
+  strncpy(label,name,sizeof(label));
+
+  bigint nbytes = n;
+  if (kind == 0) nbytes *= sizeof(int);
+  else if (kind == 1) nbytes *= sizeof(double);
+  else if (kind == 4) nbytes *= sizeof(int64_t);
+  fwrite(label,sizeof(char),sizeof(label),fp);
+  fwrite(&kind,sizeof(int),1,fp);
+  fwrite(&nbytes,sizeof(bigint),1,fp);
+  fwrite(data,sizeof(char),nbytes,fp);
+}
+
+/* ---------------------------------------------------------------------- */
+
+double ExtxyzSinkBinary::memory_usage()
+{
+  double bytes = (double) types.capacity() * sizeof(int);
+  bytes += (double) ids.capacity() * sizeof(int64_t);
+  for (auto &column : columns) bytes += (double) column.capacity() * sizeof(double);
+  for (auto &column : previous) bytes += (double) column.capacity() * sizeof(double);
+  for (auto &column : qprevious) bytes += (double) column.capacity() * sizeof(int64_t);
+  for (auto &column : encoded) bytes += (double) column.capacity();
+  return bytes;
+}
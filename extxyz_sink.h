@@ -0,0 +1,248 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_SINK_H
+#define LMP_EXTXYZ_SINK_H
+
+#include "pointers.h"
+
+#include <string>
+#include <vector>
+
+namespace LAMMPS_NS {
+
+// description of one snapshot, passed to every sink of a dump extxyz
+
+struct ExtxyzFrame {
+  bigint ntimestep;
+  bigint natoms;           // # of atoms in the full frame
+  double lattice[9];       // cell vectors a,b,c
+  std::string comment;     // comment line of the extxyz frame, no newline
+  bigint offset;           // byte offset of the frame in the dump file, -1 if unknown
+  int size_one;            // # of doubles per atom in packed rows
+  int nvalue;              // # of per-atom doubles after species
+  int vflag, fflag;        // 1 if rows hold velocities, forces
+  int idflag;              // 1 if rows are in curve order, not by ID
+};
+
+/* ----------------------------------------------------------------------
+   extra output of a dump extxyz, fed from the dump's own pack and sort
+   serial sinks are called on the rank that writes the dump file (rank 0)
+   and consume either the formatted text of the dump or packed rows:
+     text: chunks of the lines the dump itself writes, in file order
+     rows: chunks of size_one doubles per atom, ID first, in file order
+   parallel sinks are called on all ranks with their own sorted rows
+   file order is by ID, or along the curve of dump_modify order when
+   frame.idflag is set, sinks then store the ID of every atom
+------------------------------------------------------------------------- */
+
+class ExtxyzSink : protected Pointers {
+ public:
+  ExtxyzSink(class LAMMPS *, class DumpEXTXYZ *, const char *);
+  ~ExtxyzSink() override;
+
+  int rowflag;      // 1 if sink consumes packed rows, 0 if formatted text
+  int parallel;     // 1 if sink writes from all procs via write_local()
+
+  virtual int modify_param(int, char **);
+  virtual void init(int, char **) {}
+  virtual void begin_frame(const ExtxyzFrame &) {}
+  virtual void write_text(const char *, int) {}
+  virtual void write_rows(int, const double *) {}
+  virtual void end_frame() {}
+  virtual void write_local(const ExtxyzFrame &, int, const double *, bigint) {}
+  virtual double memory_usage() { return 0.0; }
+
+ protected:
+  class DumpEXTXYZ *dump;
+  char *filename;
+  int subsample;         // keep 1 of this many atoms, 1 = all
+  int hashflag;          // 1 = keep by hash of ID, 0 = ID a multiple of subsample
+  ExtxyzFrame frame;     // current frame
+
+  int selected(const double *one) const
+  {
+    if (subsample == 1) return 1;
+    uint64_t id = static_cast<tagint>(one[0]);
+    if (hashflag) id = hash_id(id);
+    return (id % subsample == 0);
+  }
+
+  // splitmix64 finalizer: stable and uniform even for regularly spaced IDs
+
+  static uint64_t hash_id(uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  int select_local(const ExtxyzFrame &, int, const double *, bigint &, bigint &);
+};
+
+/* ----------------------------------------------------------------------
+   extxyz text, compressed through an external program if the file name
+   has a compression suffix, optionally subsampled
+------------------------------------------------------------------------- */
+
+class ExtxyzSinkText : public ExtxyzSink {
+ public:
+  ExtxyzSinkText(class LAMMPS *, class DumpEXTXYZ *, const char *);
+  ~ExtxyzSinkText() override;
+
+  int modify_param(int, char **) override;
+  void init(int, char **) override;
+  void begin_frame(const ExtxyzFrame &) override;
+  void write_text(const char *, int) override;
+  void write_rows(int, const double *) override;
+  void end_frame() override;
+  double memory_usage() override;
+
+  bigint frame_offset() const { return offset; }
+  bigint frame_atoms() const { return rowflag ? nframe : frame.natoms; }
+
+ protected:
+  FILE *fp;
+  int compressed;
+  bigint nframe;            // # of atoms in current subsampled frame
+  bigint offset;            // file offset of current frame, -1 if compressed
+  std::vector<char> text;   // subsampled lines of current frame
+};
+
+/* ----------------------------------------------------------------------
+   latest snapshot only: every Nth frame is written as extxyz text to
+   FILE.tmp, which is then renamed to FILE, so readers of FILE always see
+   one complete frame
+------------------------------------------------------------------------- */
+
+class ExtxyzSinkLatest : public ExtxyzSinkText {
+ public:
+  ExtxyzSinkLatest(class LAMMPS *, class DumpEXTXYZ *, const char *);
+
+  int modify_param(int, char **) override;
+  void init(int, char **) override;
+  void begin_frame(const ExtxyzFrame &) override;
+  void write_text(const char *, int) override;
+  void write_rows(int, const double *) override;
+  void end_frame() override;
+
+ protected:
+  int every;                // write 1 of this many frames
+  bigint nseen;             // # of frames seen
+  int active;               // 1 if current frame is written
+  std::string tmpname;
+};
+
+/* ----------------------------------------------------------------------
+   level-of-detail pyramid: extxyz text levels BASE.lod1.xyz ... keeping
+   1/F, 1/F^2, ... of the atoms by hash of their ID, so each level is a
+   subset of the one before, and an index BASE.lod.json with one JSON line
+   per frame: {"step":S,"levels":[[factor,natoms,offset],...]}
+   level 0 (factor 1) is the dump file itself, with the frame's offset in
+   it or -1 if the dump file has no byte offsets
+------------------------------------------------------------------------- */
+
+class ExtxyzSinkLOD : public ExtxyzSink {
+ public:
+  ExtxyzSinkLOD(class LAMMPS *, class DumpEXTXYZ *, const char *);
+  ~ExtxyzSinkLOD() override;
+
+  int modify_param(int, char **) override;
+  void init(int, char **) override;
+  void begin_frame(const ExtxyzFrame &) override;
+  void write_rows(int, const double *) override;
+  void end_frame() override;
+  double memory_usage() override;
+
+ protected:
+  int nlevel;                              // # of decimated levels
+  int factor;                              // decimation between levels
+  FILE *fp;                                // level index
+  std::vector<ExtxyzSinkText *> levels;
+};
+
+/* ----------------------------------------------------------------------
+   binary columnar frames:
+     file  = "EXTXYZB1", int32 ntypes, ntypes x (int32 len, species name)
+     frame = int64 timestep, int64 natoms, double lattice[9], int32 ncol,
+             ncol x (char name[8], int32 kind, int64 nbytes, data)
+   kind 0 = int32 per atom, 1 = float64 per atom, 4 = int64 per atom,
+        2 = float64 per atom, losslessly encoded (codec shuffle):
+            uint8 delta, uint8 entropy coder, int64 raw bytes, payload
+        3 = float64 per atom, quantized (positions with codec lossy):
+            double step, uint8 delta, uint8 entropy coder, int64 raw bytes, payload
+   columns are type (kind 0), the float columns x ... fz, then id (kind 4)
+   if the dump is in curve order, so rows are not sorted by ID
+   encoding of kind 2: if delta = 1, the 64-bit pattern of each value is
+   XORed with the value of the same row and column of the previous frame,
+   then the 8 byte planes are transposed (all 1st bytes, all 2nd bytes, ...)
+   encoding of kind 3: value = q*step with integer q, |error| <= step/2;
+   residual = q - q of same row in previous frame if delta = 1, else
+   q - q of previous row (0 for 1st row), stored as LEB128 varints of
+   zigzag(residual); previous frame must then be decoded as kind 3 too
+   the previous frame of a kind 2 column with delta = 1 is its decoded
+   value, i.e. q*step if that column was kind 3
+   raw bytes are then coded with zstd (coder 1) or zero-run-length (coder 0):
+     control byte c < 128: c+1 literal bytes follow, else c-127 zero bytes
+   with level auto the coder and zstd level change between frames: the
+   level moves toward the side of encode time versus write time that is
+   smaller, a move that makes the frame cost per raw byte worse is undone
+------------------------------------------------------------------------- */
+
+class ExtxyzSinkBinary : public ExtxyzSink {
+ public:
+  ExtxyzSinkBinary(class LAMMPS *, class DumpEXTXYZ *, const char *);
+  ~ExtxyzSinkBinary() override;
+
+  int modify_param(int, char **) override;
+  void init(int, char **) override;
+  void begin_frame(const ExtxyzFrame &) override;
+  void write_rows(int, const double *) override;
+  void end_frame() override;
+  double memory_usage() override;
+
+ protected:
+  FILE *fp;
+  bigint nframe;                              // # of atoms in current frame
+  std::vector<int> types;                     // species column
+  std::vector<int64_t> ids;                   // ID column, kept in curve order
+  int idcolumn;                               // 1 if ids is kept in every order
+  std::vector<std::vector<double>> columns;   // one vector per value column
+
+  int codec;                                  // NOCODEC, SHUFFLE or LOSSY
+  int level;                                  // zstd compression level
+  int adaptflag;                              // 1 if level is chosen per frame
+  int rung;                                   // index of level in the ladder
+  int lastrung;                               // rung of the previous frame
+  int hold;                                   // # of frames before the next move
+  double lastcost;                            // seconds per raw byte of last frame
+  double encodetime, writetime;               // seconds spent in all frames
+  int nchange;                                // # of level changes
+  std::vector<bigint> rungframes;             // # of frames coded at each rung
+  double tolerance;                           // absolute error bound of codec lossy
+  bigint rawbytes, filebytes;                 // float column bytes before/after coding
+  std::vector<std::vector<double>> previous;  // columns of previous frame
+  std::vector<std::vector<int64_t>> qprevious;   // quantized columns of previous frame
+  std::vector<std::vector<char>> encoded;     // encoded columns of current frame
+  std::vector<int> kinds;                     // column kind of encoded columns
+
+  virtual void write_column(const char *, int, const void *, bigint);
+  void encode_column(int);
+  int quantize_column(int);
+  void adapt_level(double, double, bigint);
+  static void entropy_code(std::vector<char> &, int, const unsigned char *, int64_t, int);
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
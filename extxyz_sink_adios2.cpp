@@ -0,0 +1,187 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifdef EXTXYZ_ADIOS2
+
+#include "extxyz_sink_adios2.h"
+
+#include "comm.h"
+#include "error.h"
+#include "update.h"
+
+#include <cstring>
+#include <exception>
+#include <vector>
+
+using namespace LAMMPS_NS;
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkADIOS2::ExtxyzSinkADIOS2(LAMMPS *lmp, DumpEXTXYZ *ptr, const char *name) :
+  ExtxyzSink(lmp,ptr,name), adios(nullptr)
+{
+  parallel = 1;
+  engine_type = "BP5";
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkADIOS2::~ExtxyzSinkADIOS2()
+{
+  if (engine) engine.Close();
+  delete adios;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ExtxyzSinkADIOS2::modify_param(int narg, char **arg)
+{
+  if (strcmp(arg[0],"engine") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    engine_type = arg[1];
+    return 2;
+  }
+
+  if (strcmp(arg[0],"aggregators") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    int n = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (n < 1) error->all(FLERR,"Illegal dump_modify sink aggregators: {}",arg[1]);
+    aggregators = arg[1];
+    return 2;
+  }
+
+  return ExtxyzSink::modify_param(narg,arg);
+}
+
+/* ----------------------------------------------------------------------
+   open the ADIOS2 engine, called by all procs
+   variables whose presence depends on the frame are defined at 1st frame
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkADIOS2::init(int ntypes, char **typenames)
+{
+  if (adios) return;
+
+  try {
+    adios = new adios2::ADIOS(world);
+    io = adios->DeclareIO("extxyz");
+    io.SetEngine(engine_type);
+    if (!aggregators.empty()) io.SetParameter("NumAggregators",aggregators);
+
+    std::vector<std::string> names;
+    for (int itype = 1; itype <= ntypes; itype++) names.emplace_back(typenames[itype]);
+    io.DefineAttribute<std::string>("species_names",names.data(),names.size());
+
+    step = io.DefineVariable<int64_t>("step");
+    time = io.DefineVariable<double>("time");
+    natoms = io.DefineVariable<int64_t>("natoms");
+    lattice = io.DefineVariable<double>("lattice",{9},{0},{9},true);
+    comment = io.DefineVariable<std::string>("comment");
+
+    engine = io.Open(filename,adios2::Mode::Write);
+  } catch (std::exception &e) {
+    error->all(FLERR,"Cannot open dump extxyz sink file {} with ADIOS2 engine {}: {}",
+               filename,engine_type,e.what());
+  }
+}
+
+/* ----------------------------------------------------------------------
+   write one frame as one ADIOS step, called by all procs with their
+   sorted rows, offset = index of my 1st row in the full frame
+   global array shapes follow the # of atoms of each frame
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkADIOS2::write_local(const ExtxyzFrame &frame, int n, const double *rows,
+                                   bigint offset)
+{
+  bigint ntotal;
+  int nsel = select_local(frame,n,rows,offset,ntotal);
+
+  if (!species) {
+    const size_t one = 1, three = 3;
+    species = io.DefineVariable<int>("species",{one},{0},{one});
+    position = io.DefineVariable<double>("position",{one,three},{0,0},{one,three});
+    if (frame.vflag)
+      velocity = io.DefineVariable<double>("velocity",{one,three},{0,0},{one,three});
+    if (frame.fflag)
+      force = io.DefineVariable<double>("force",{one,three},{0,0},{one,three});
+  }
+  if (frame.idflag && !id) id = io.DefineVariable<int64_t>("id",{1},{0},{1});
+
+  std::vector<int> type(nsel);
+  std::vector<int64_t> ids;
+  std::vector<double> x(3*nsel), v, f;
+  if (frame.idflag) ids.resize(nsel);
+  if (velocity) v.resize(3*nsel);
+  if (force) f.resize(3*nsel);
+
+  int m = 0;
+  for (int i = 0; i < n; i++) {
+    const double *one = &rows[i*frame.size_one];
+    if (!selected(one)) continue;
+    type[m] = static_cast<int>(one[1]);
+    for (int k = 0; k < 3; k++) x[3*m+k] = one[2+k];
+    int col = 5;
+    if (frame.vflag) {
+      if (velocity) for (int k = 0; k < 3; k++) v[3*m+k] = one[col+k];
+      col += 3;
+    }
+    if (frame.fflag && force) for (int k = 0; k < 3; k++) f[3*m+k] = one[col+k];
+    if (ids.size()) ids[m] = static_cast<int64_t>(one[0]);
+    m++;
+  }
+
+  // Put() is deferred: all buffers must live until EndStep()
+
+  engine.BeginStep();
+
+  species.SetShape({(size_t) ntotal});
+  species.SetSelection({{(size_t) offset},{(size_t) nsel}});
+  if (nsel) engine.Put(species,type.data());
+  if (frame.idflag) {
+    id.SetShape({(size_t) ntotal});
+    id.SetSelection({{(size_t) offset},{(size_t) nsel}});
+    if (nsel) engine.Put(id,ids.data());
+  }
+  put_atoms(position,x,ntotal,nsel,offset);
+  if (velocity) put_atoms(velocity,v,ntotal,nsel,offset);
+  if (force) put_atoms(force,f,ntotal,nsel,offset);
+
+  // per-frame data comes from proc 0
+
+  int64_t nstep = frame.ntimestep;
+  int64_t nframe = ntotal;
+  double now = update->atime + (update->ntimestep - update->atimestep) * update->dt;
+  if (comm->me == 0) {
+    engine.Put(step,nstep,adios2::Mode::Sync);
+    engine.Put(time,now,adios2::Mode::Sync);
+    engine.Put(natoms,nframe,adios2::Mode::Sync);
+    engine.Put(lattice,frame.lattice);
+    engine.Put(comment,frame.comment,adios2::Mode::Sync);
+  }
+
+  engine.EndStep();
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkADIOS2::put_atoms(adios2::Variable<double> &var, const std::vector<double> &data,
+                                 bigint ntotal, int n, bigint offset)
+{
+  var.SetShape({(size_t) ntotal,3});
+  var.SetSelection({{(size_t) offset,0},{(size_t) n,3}});
+  if (n) engine.Put(var,data.data());
+}
+
+#endif
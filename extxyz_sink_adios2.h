@@ -0,0 +1,64 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_SINK_ADIOS2_H
+#define LMP_EXTXYZ_SINK_ADIOS2_H
+
+#ifdef EXTXYZ_ADIOS2
+
+#include "extxyz_sink.h"
+
+#include <adios2.h>
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   ADIOS2 output written by all procs, one ADIOS step per frame
+   engine is BP5 (file) by default or any other ADIOS2 engine, e.g. SST
+   to stream frames to a reader running alongside LAMMPS
+     global arrays: species[natoms], position[natoms][3],
+                    velocity[natoms][3], force[natoms][3], id[natoms]
+                    (id in curve order only, rows are then not by ID)
+     single values: step, time, natoms, lattice[9], comment
+     attribute:     species_names = names of atom types
+------------------------------------------------------------------------- */
+
+class ExtxyzSinkADIOS2 : public ExtxyzSink {
+ public:
+  ExtxyzSinkADIOS2(class LAMMPS *, class DumpEXTXYZ *, const char *);
+  ~ExtxyzSinkADIOS2() override;
+
+  int modify_param(int, char **) override;
+  void init(int, char **) override;
+  void write_local(const ExtxyzFrame &, int, const double *, bigint) override;
+
+ protected:
+  adios2::ADIOS *adios;
+  adios2::IO io;
+  adios2::Engine engine;
+  std::string engine_type;     // ADIOS2 engine name
+  std::string aggregators;     // # of BP5 aggregators, empty = ADIOS2 default
+
+  adios2::Variable<int> species;
+  adios2::Variable<double> position, velocity, force, lattice;
+  adios2::Variable<int64_t> step, natoms, id;
+  adios2::Variable<double> time;
+  adios2::Variable<std::string> comment;
+
+  void put_atoms(adios2::Variable<double> &, const std::vector<double> &, bigint, int, bigint);
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
+#endif
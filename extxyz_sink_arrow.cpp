@@ -0,0 +1,152 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifdef EXTXYZ_ARROW
+
+#include "extxyz_sink_arrow.h"
+
+#include "error.h"
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+
+#include <cstring>
+
+using namespace LAMMPS_NS;
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkArrow::ExtxyzSinkArrow(LAMMPS *lmp, DumpEXTXYZ *ptr, const char *name) :
+  ExtxyzSinkBinary(lmp,ptr,name)
+{
+  stream = 0;
+  idcolumn = 1;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkArrow::~ExtxyzSinkArrow()
+{
+  if (writer) writer->Close().Warn();
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ExtxyzSinkArrow::modify_param(int narg, char **arg)
+{
+  if (strcmp(arg[0],"format") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    if (strcmp(arg[1],"file") == 0) stream = 0;
+    else if (strcmp(arg[1],"stream") == 0) stream = 1;
+    else error->all(FLERR,"Illegal dump_modify sink format: {}",arg[1]);
+    return 2;
+  }
+
+  return ExtxyzSink::modify_param(narg,arg);
+}
+
+/* ----------------------------------------------------------------------
+   species names become the dictionary of the species column,
+   file is opened at the 1st frame when the columns are known
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkArrow::init(int ntypes, char **typenames)
+{
+  if (dictionary) return;
+
+  arrow::StringBuilder builder;
+  for (int itype = 1; itype <= ntypes; itype++) {
+    auto status = builder.Append(typenames[itype]);
+    if (!status.ok()) error->one(FLERR,"Dump extxyz sink arrow: {}",status.ToString());
+  }
+  auto status = builder.Finish(&dictionary);
+  if (!status.ok()) error->one(FLERR,"Dump extxyz sink arrow: {}",status.ToString());
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkArrow::open(const ExtxyzFrame &f)
+{
+  static const char *names[9] = {"x","y","z","vx","vy","vz","fx","fy","fz"};
+
+  arrow::FieldVector fields;
+  fields.push_back(arrow::field("id",arrow::int64(),false));
+  fields.push_back(arrow::field("species",arrow::dictionary(arrow::int32(),arrow::utf8()),false));
+  for (int igroup = 0; igroup < 3; igroup++) {
+    if (igroup == 1 && !f.vflag) continue;
+    if (igroup == 2 && !f.fflag) continue;
+    for (int dim = 0; dim < 3; dim++)
+      fields.push_back(arrow::field(names[3*igroup+dim],arrow::float64(),false));
+  }
+  schema = arrow::schema(fields);
+
+  auto out = arrow::io::FileOutputStream::Open(filename);
+  if (!out.ok())
+    error->one(FLERR,"Cannot open dump extxyz sink file {}: {}",filename,
+               out.status().ToString());
+
+  auto result = stream ? arrow::ipc::MakeStreamWriter(*out,schema)
+                       : arrow::ipc::MakeFileWriter(*out,schema);
+  if (!result.ok())
+    error->one(FLERR,"Cannot write dump extxyz sink file {}: {}",filename,
+               result.status().ToString());
+  writer = *result;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkArrow::begin_frame(const ExtxyzFrame &f)
+{
+  if (!writer) open(f);
+  ExtxyzSinkBinary::begin_frame(f);
+}
+
+/* ----------------------------------------------------------------------
+   write the frame as one record batch, column buffers are wrapped
+   without a copy and stay alive until the batch is written
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkArrow::end_frame()
+{
+  std::vector<std::shared_ptr<arrow::Array>> arrays;
+  arrays.push_back(std::make_shared<arrow::Int64Array>(nframe,arrow::Buffer::Wrap(ids)));
+
+  // dictionary indices are 0-based atom types
+
+  for (auto &itype : types) itype--;
+  auto indices = std::make_shared<arrow::Int32Array>(nframe,arrow::Buffer::Wrap(types));
+  auto species = arrow::DictionaryArray::FromArrays(schema->field(1)->type(),indices,dictionary);
+  if (!species.ok())
+    error->one(FLERR,"Dump extxyz sink arrow: {}",species.status().ToString());
+  arrays.push_back(*species);
+
+  for (auto &column : columns)
+    arrays.push_back(std::make_shared<arrow::DoubleArray>(nframe,arrow::Buffer::Wrap(column)));
+
+  auto batch = arrow::RecordBatch::Make(schema,nframe,arrays);
+
+  auto metadata = arrow::key_value_metadata(
+    {"timestep","natoms","Lattice","comment"},
+    {std::to_string(frame.ntimestep),std::to_string(nframe),
+     fmt::format("{} {} {} {} {} {} {} {} {}",frame.lattice[0],frame.lattice[1],frame.lattice[2],
+                 frame.lattice[3],frame.lattice[4],frame.lattice[5],frame.lattice[6],
+                 frame.lattice[7],frame.lattice[8]),
+     frame.comment});
+
+  auto status = writer->WriteRecordBatch(*batch,metadata);
+  if (!status.ok()) error->one(FLERR,"Dump extxyz sink arrow: {}",status.ToString());
+}
+
+#endif
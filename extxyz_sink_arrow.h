@@ -0,0 +1,64 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_SINK_ARROW_H
+#define LMP_EXTXYZ_SINK_ARROW_H
+
+#ifdef EXTXYZ_ARROW
+
+#include "extxyz_sink.h"
+
+#include <memory>
+
+namespace arrow {
+class Array;
+class Schema;
+namespace ipc {
+  class RecordBatchWriter;
+}
+}    // namespace arrow
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   Apache Arrow IPC file (Feather v2) or stream, one record batch per frame
+     columns  = id (int64), species (dictionary int32 -> utf8),
+                x y z [vx vy vz] [fx fy fz] (float64)
+     metadata = per batch: timestep, natoms, Lattice, comment
+   columns are filled from the packed rows of the dump, the IPC file can
+   be memory-mapped by readers without parsing
+------------------------------------------------------------------------- */
+
+class ExtxyzSinkArrow : public ExtxyzSinkBinary {
+ public:
+  ExtxyzSinkArrow(class LAMMPS *, class DumpEXTXYZ *, const char *);
+  ~ExtxyzSinkArrow() override;
+
+  int modify_param(int, char **) override;
+  void init(int, char **) override;
+  void begin_frame(const ExtxyzFrame &) override;
+  void end_frame() override;
+
+ protected:
+  int stream;                                     // 1 = IPC stream, 0 = IPC file
+  std::shared_ptr<arrow::Array> dictionary;       // species names
+  std::shared_ptr<arrow::Schema> schema;
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> writer;
+
+  void open(const ExtxyzFrame &);
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
+#endif
@@ -0,0 +1,362 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifdef EXTXYZ_HDF5
+
+#include "extxyz_sink_h5md.h"
+
+#include "comm.h"
+#include "domain.h"
+#include "error.h"
+#include "lammps.h"
+#include "update.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace LAMMPS_NS;
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkH5MD::ExtxyzSinkH5MD(LAMMPS *lmp, DumpEXTXYZ *ptr, const char *name) :
+  ExtxyzSink(lmp,ptr,name)
+{
+  parallel = 1;
+  file = particles = step = time = dxpl = -1;
+  deflate = 0;
+  natoms = -1;
+  nframes = 0;
+
+  Element *elements[6] = {&species,&position,&velocity,&force,&id,&edges};
+  for (auto e : elements) {
+    e->group = e->value = -1;
+    e->ncomp = e->peratom = 0;
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzSinkH5MD::~ExtxyzSinkH5MD()
+{
+  Element *elements[6] = {&species,&position,&velocity,&force,&id,&edges};
+  for (auto e : elements) {
+    if (e->value >= 0) H5Dclose(e->value);
+    if (e->group >= 0) H5Gclose(e->group);
+  }
+
+  if (step >= 0) H5Dclose(step);
+  if (time >= 0) H5Dclose(time);
+  if (particles >= 0) H5Gclose(particles);
+  if (dxpl >= 0) H5Pclose(dxpl);
+  if (file >= 0) H5Fclose(file);
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ExtxyzSinkH5MD::modify_param(int narg, char **arg)
+{
+  if (strcmp(arg[0],"compress") == 0) {
+    if (narg < 2) error->all(FLERR,"Illegal dump_modify sink command");
+    deflate = utils::inumeric(FLERR,arg[1],false,lmp);
+    if (deflate < 0 || deflate > 9)
+      error->all(FLERR,"Illegal dump_modify sink compress level: {}",arg[1]);
+    return 2;
+  }
+
+  return ExtxyzSink::modify_param(narg,arg);
+}
+
+/* ----------------------------------------------------------------------
+   create file and the frame-independent part of the H5MD layout
+   called by all procs, file access is collective with parallel HDF5
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkH5MD::init(int ntypes, char **typenames)
+{
+  if (file >= 0) return;
+
+#ifndef H5_HAVE_PARALLEL
+  if (comm->nprocs > 1)
+    error->all(FLERR,"Dump extxyz sink h5md needs parallel HDF5 to run on more than one proc");
+#endif
+
+  hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+  dxpl = H5Pcreate(H5P_DATASET_XFER);
+#ifdef H5_HAVE_PARALLEL
+  H5Pset_fapl_mpio(fapl,world,MPI_INFO_NULL);
+  H5Pset_dxpl_mpio(dxpl,H5FD_MPIO_COLLECTIVE);
+#endif
+  file = H5Fcreate(filename,H5F_ACC_TRUNC,H5P_DEFAULT,fapl);
+  H5Pclose(fapl);
+  if (file < 0) error->all(FLERR,"Cannot open dump extxyz sink file {}",filename);
+
+  // H5MD metadata
+
+  hid_t h5md = H5Gcreate2(file,"h5md",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  int version[2] = {1,1};
+  hsize_t two = 2;
+  hid_t space = H5Screate_simple(1,&two,nullptr);
+  hid_t attr = H5Acreate2(h5md,"version",H5T_STD_I32LE,space,H5P_DEFAULT,H5P_DEFAULT);
+  H5Awrite(attr,H5T_NATIVE_INT,version);
+  H5Aclose(attr);
+  H5Sclose(space);
+
+  hid_t group = H5Gcreate2(h5md,"author",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  write_attribute(group,"name","LAMMPS");
+  H5Gclose(group);
+  group = H5Gcreate2(h5md,"creator",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  write_attribute(group,"name","LAMMPS dump extxyz");
+  write_attribute(group,"version",lmp->version);
+  H5Gclose(group);
+  H5Gclose(h5md);
+
+  // particle group and simulation box
+
+  group = H5Gcreate2(file,"particles",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  particles = H5Gcreate2(group,"all",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  H5Gclose(group);
+
+  hid_t box = H5Gcreate2(particles,"box",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  int dimension = 3;
+  space = H5Screate(H5S_SCALAR);
+  attr = H5Acreate2(box,"dimension",H5T_STD_I32LE,space,H5P_DEFAULT,H5P_DEFAULT);
+  H5Awrite(attr,H5T_NATIVE_INT,&dimension);
+  H5Aclose(attr);
+  H5Sclose(space);
+
+  char boundary[3][9];
+  for (int dim = 0; dim < 3; dim++)
+    strcpy(boundary[dim],domain->periodicity[dim] ? "periodic" : "none");
+  hsize_t three = 3;
+  hid_t strtype = H5Tcopy(H5T_C_S1);
+  H5Tset_size(strtype,9);
+  space = H5Screate_simple(1,&three,nullptr);
+  attr = H5Acreate2(box,"boundary",strtype,space,H5P_DEFAULT,H5P_DEFAULT);
+  H5Awrite(attr,strtype,boundary);
+  H5Aclose(attr);
+  H5Sclose(space);
+  H5Tclose(strtype);
+  H5Gclose(box);
+
+  // species names of atom types, written by proc 0 only
+
+  int maxlen = 1;
+  for (int itype = 1; itype <= ntypes; itype++)
+    maxlen = MAX(maxlen,(int) strlen(typenames[itype]) + 1);
+  std::vector<char> names((size_t) ntypes * maxlen,'\0');
+  for (int itype = 1; itype <= ntypes; itype++)
+    strcpy(&names[(size_t) (itype-1) * maxlen],typenames[itype]);
+
+  group = H5Gcreate2(file,"parameters",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  hid_t params = H5Gcreate2(group,"extxyz",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  hsize_t ntype = ntypes;
+  strtype = H5Tcopy(H5T_C_S1);
+  H5Tset_size(strtype,maxlen);
+  space = H5Screate_simple(1,&ntype,nullptr);
+  hid_t dset = H5Dcreate2(params,"species",strtype,space,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  if (comm->me == 0) H5Dwrite(dset,strtype,H5S_ALL,H5S_ALL,H5P_DEFAULT,names.data());
+  H5Dclose(dset);
+  H5Sclose(space);
+  H5Tclose(strtype);
+  H5Gclose(params);
+  H5Gclose(group);
+}
+
+/* ----------------------------------------------------------------------
+   append one frame, called by all procs with their sorted rows
+   offset = index of my 1st row in the full frame
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkH5MD::write_local(const ExtxyzFrame &frame, int n, const double *rows,
+                                 bigint offset)
+{
+  // subsampling changes the count and offset of my rows
+
+  bigint ntotal;
+  int nsel = select_local(frame,n,rows,offset,ntotal);
+
+  if (natoms < 0) {
+    natoms = ntotal;
+    create_elements(frame);
+  } else if (ntotal != natoms)
+    error->all(FLERR,"Dump extxyz sink h5md requires the same # of atoms in every frame");
+  if (frame.idflag && id.value < 0)
+    error->all(FLERR,"Dump extxyz sink h5md cannot switch to dump_modify order morton or "
+               "hilbert after its 1st frame");
+
+  std::vector<int> type(nsel);
+  std::vector<int64_t> ids;
+  std::vector<double> x(3*nsel), v, f;
+  if (id.value >= 0) ids.resize(nsel);
+  if (velocity.value >= 0) v.resize(3*nsel);
+  if (force.value >= 0) f.resize(3*nsel);
+
+  int m = 0;
+  for (int i = 0; i < n; i++) {
+    const double *one = &rows[i*frame.size_one];
+    if (!selected(one)) continue;
+    type[m] = static_cast<int>(one[1]);
+    for (int k = 0; k < 3; k++) x[3*m+k] = one[2+k];
+    int col = 5;
+    if (frame.vflag) {
+      if (v.size()) for (int k = 0; k < 3; k++) v[3*m+k] = one[col+k];
+      col += 3;
+    }
+    if (frame.fflag && f.size()) for (int k = 0; k < 3; k++) f[3*m+k] = one[col+k];
+    if (ids.size()) ids[m] = static_cast<int64_t>(one[0]);
+    m++;
+  }
+
+  append(species.value,1,1,H5T_NATIVE_INT,type.data(),nsel,offset);
+  append(position.value,1,3,H5T_NATIVE_DOUBLE,x.data(),nsel,offset);
+  if (velocity.value >= 0) append(velocity.value,1,3,H5T_NATIVE_DOUBLE,v.data(),nsel,offset);
+  if (force.value >= 0) append(force.value,1,3,H5T_NATIVE_DOUBLE,f.data(),nsel,offset);
+  if (id.value >= 0) append(id.value,1,1,H5T_NATIVE_INT64,ids.data(),nsel,offset);
+
+  // per-frame data comes from proc 0
+
+  int nme = (comm->me == 0) ? 1 : 0;
+  double edge[3] = {frame.lattice[0],frame.lattice[4],frame.lattice[8]};
+  double now = update->atime + (update->ntimestep - update->atimestep) * update->dt;
+  append(edges.value,0,3,H5T_NATIVE_DOUBLE,edge,nme,0);
+  append(step,0,1,H5T_NATIVE_LLONG,&frame.ntimestep,nme,0);
+  append(time,0,1,H5T_NATIVE_DOUBLE,&now,nme,0);
+
+  nframes++;
+  H5Fflush(file,H5F_SCOPE_LOCAL);
+}
+
+/* ----------------------------------------------------------------------
+   create time-dependent elements once the # of atoms is known
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkH5MD::create_elements(const ExtxyzFrame &frame)
+{
+  create_element(species,particles,"species",H5T_STD_I32LE,1,1);
+  create_element(position,particles,"position",H5T_IEEE_F64LE,3,1);
+  if (frame.vflag) create_element(velocity,particles,"velocity",H5T_IEEE_F64LE,3,1);
+  if (frame.fflag) create_element(force,particles,"force",H5T_IEEE_F64LE,3,1);
+  if (frame.idflag) create_element(id,particles,"id",H5T_STD_I64LE,1,1);
+
+  hid_t box = H5Gopen2(particles,"box",H5P_DEFAULT);
+  create_element(edges,box,"edges",H5T_IEEE_F64LE,3,0);
+  H5Gclose(box);
+}
+
+/* ----------------------------------------------------------------------
+   create one element group with a chunked, extendable value dataset
+   the step and time datasets of species, the 1st element, are linked
+   into all others
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkH5MD::create_element(Element &e, hid_t parent, const char *name, hid_t type,
+                                    int ncomp, int peratom)
+{
+  e.group = H5Gcreate2(parent,name,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+  e.ncomp = ncomp;
+  e.peratom = peratom;
+
+  hsize_t dims[3],maxdims[3],chunk[3];
+  int rank = 0;
+  dims[rank] = 0;
+  maxdims[rank] = H5S_UNLIMITED;
+  chunk[rank++] = 1;
+  if (peratom) {
+    dims[rank] = maxdims[rank] = natoms;
+    chunk[rank++] = MAX(1,MIN(natoms,65536));
+  }
+  if (ncomp > 1) {
+    dims[rank] = maxdims[rank] = ncomp;
+    chunk[rank++] = ncomp;
+  }
+
+  hid_t space = H5Screate_simple(rank,dims,maxdims);
+  hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(dcpl,rank,chunk);
+  if (deflate) H5Pset_deflate(dcpl,deflate);
+  e.value = H5Dcreate2(e.group,"value",type,space,H5P_DEFAULT,dcpl,H5P_DEFAULT);
+  H5Pclose(dcpl);
+  H5Sclose(space);
+
+  if (step >= 0) {
+    H5Lcreate_hard(file,"/particles/all/species/step",e.group,"step",H5P_DEFAULT,H5P_DEFAULT);
+    H5Lcreate_hard(file,"/particles/all/species/time",e.group,"time",H5P_DEFAULT,H5P_DEFAULT);
+    return;
+  }
+
+  hsize_t zero = 0, unlimited = H5S_UNLIMITED, nchunk = 64;
+  space = H5Screate_simple(1,&zero,&unlimited);
+  dcpl = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(dcpl,1,&nchunk);
+  step = H5Dcreate2(e.group,"step",H5T_STD_I64LE,space,H5P_DEFAULT,dcpl,H5P_DEFAULT);
+  time = H5Dcreate2(e.group,"time",H5T_IEEE_F64LE,space,H5P_DEFAULT,dcpl,H5P_DEFAULT);
+  H5Pclose(dcpl);
+  H5Sclose(space);
+}
+
+/* ----------------------------------------------------------------------
+   extend dataset by one frame and write n entries starting at offset
+   collective: every proc calls this, possibly with n = 0
+------------------------------------------------------------------------- */
+
+void ExtxyzSinkH5MD::append(hid_t dset, int peratom, int ncomp, hid_t memtype,
+                            const void *data, int n, bigint offset)
+{
+  hsize_t dims[3],start[3],count[3];
+  int rank = 0;
+  dims[rank] = nframes + 1;
+  start[rank] = nframes;
+  count[rank++] = 1;
+  if (peratom) {
+    dims[rank] = natoms;
+    start[rank] = offset;
+    count[rank++] = n;
+  }
+  if (ncomp > 1) {
+    dims[rank] = ncomp;
+    start[rank] = 0;
+    count[rank++] = ncomp;
+  }
+
+  H5Dset_extent(dset,dims);
+  hid_t filespace = H5Dget_space(dset);
+  hsize_t nmem = MAX((hsize_t) n * ncomp,1);
+  hid_t memspace = H5Screate_simple(1,&nmem,nullptr);
+
+  if (n) H5Sselect_hyperslab(filespace,H5S_SELECT_SET,start,nullptr,count,nullptr);
+  else {
+    H5Sselect_none(filespace);
+    H5Sselect_none(memspace);
+  }
+
+  H5Dwrite(dset,memtype,memspace,filespace,dxpl,data);
+  H5Sclose(memspace);
+  H5Sclose(filespace);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzSinkH5MD::write_attribute(hid_t obj, const char *name, const char *value)
+{
+  hid_t strtype = H5Tcopy(H5T_C_S1);
+  H5Tset_size(strtype,strlen(value) + 1);
+  hid_t space = H5Screate(H5S_SCALAR);
+  hid_t attr = H5Acreate2(obj,name,strtype,space,H5P_DEFAULT,H5P_DEFAULT);
+  H5Awrite(attr,strtype,value);
+  H5Aclose(attr);
+  H5Sclose(space);
+  H5Tclose(strtype);
+}
+
+#endif
@@ -0,0 +1,70 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_SINK_H5MD_H
+#define LMP_EXTXYZ_SINK_H5MD_H
+
+#ifdef EXTXYZ_HDF5
+
+#include "extxyz_sink.h"
+
+#include <hdf5.h>
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   H5MD file written by all procs, each proc writes the hyperslab of its
+   sorted rows; time is the extendable 1st dimension of every element
+     /particles/all/{species,position,velocity,force,id}/{step,time,value}
+     /particles/all/box/edges/{step,time,value}
+     /parameters/extxyz/species = names of atom types
+   id is written when the dump is in curve order, rows are then not by ID
+------------------------------------------------------------------------- */
+
+class ExtxyzSinkH5MD : public ExtxyzSink {
+ public:
+  ExtxyzSinkH5MD(class LAMMPS *, class DumpEXTXYZ *, const char *);
+  ~ExtxyzSinkH5MD() override;
+
+  int modify_param(int, char **) override;
+  void init(int, char **) override;
+  void write_local(const ExtxyzFrame &, int, const double *, bigint) override;
+
+ protected:
+  // one time-dependent H5MD element
+
+  struct Element {
+    hid_t group, value;
+    int ncomp;             // values per atom (or per frame for box edges)
+    int peratom;           // 1 if value has an atom dimension
+  };
+
+  hid_t file, particles;
+  hid_t step, time;        // shared by all elements via hard links
+  hid_t dxpl;              // data transfer property list
+  int deflate;             // gzip level of chunked values, 0 = off
+  bigint natoms;           // # of atoms per frame, fixed by 1st frame
+  hsize_t nframes;         // # of frames written
+
+  Element species, position, velocity, force, id, edges;
+
+  void create_elements(const ExtxyzFrame &);
+  void create_element(Element &, hid_t, const char *, hid_t, int, int);
+  void append(hid_t, int, int, hid_t, const void *, int, bigint);
+  void write_attribute(hid_t, const char *, const char *);
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
+#endif
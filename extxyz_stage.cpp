@@ -0,0 +1,183 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#include "extxyz_stage.h"
+
+#include "extxyz_trace.h"
+
+#include "platform.h"
+
+#include <vector>
+
+using namespace LAMMPS_NS;
+
+static constexpr size_t CHUNK = 1 << 22;
+
+/* ----------------------------------------------------------------------
+   stage frames of final file fp, now at offset start, in directory dir
+   segments are named dir/name.SEQ.seg
+------------------------------------------------------------------------- */
+
+ExtxyzStage::ExtxyzStage(FILE *ptr, bigint start, const std::string &dir,
+                         const std::string &name, bigint maxbytes) :
+  fp(ptr), limit(maxbytes), offset(start), segfp(nullptr), nsegment(0), staged(0),
+  quit(false), errflag(0), trace(nullptr)
+{
+  prefix = platform::path_join(dir,name);
+  current.nbytes = 0;
+  thread = std::thread(&ExtxyzStage::loop,this);
+}
+
+/* ----------------------------------------------------------------------
+   final flush: stage what is left, drain all segments, stop the thread
+------------------------------------------------------------------------- */
+
+ExtxyzStage::~ExtxyzStage()
+{
+  submit();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cond.notify_all();
+  thread.join();
+}
+
+/* ----------------------------------------------------------------------
+   write bytes of the current frame to its segment at local speed
+------------------------------------------------------------------------- */
+
+void ExtxyzStage::append(const char *str, size_t n)
+{
+  if (!segfp) {
+    current.name = prefix + "." + std::to_string(nsegment++) + ".seg";
+    current.nbytes = 0;
+    segfp = fopen(current.name.c_str(),"wb");
+    if (!segfp) {
+      std::lock_guard<std::mutex> lock(mutex);
+      errflag = 1;
+      return;
+    }
+  }
+
+  if (fwrite(str,sizeof(char),n,segfp) != n) {
+    std::lock_guard<std::mutex> lock(mutex);
+    errflag = 1;
+  }
+  current.nbytes += n;
+  offset += n;
+}
+
+/* ----------------------------------------------------------------------
+   close the segment of the current frame and queue it for draining,
+   then wait while the staging directory holds more than limit bytes
+   nothing is queued after an error, later frames would leave a gap
+------------------------------------------------------------------------- */
+
+void ExtxyzStage::submit()
+{
+  if (!segfp) return;
+
+  int flag = fclose(segfp);
+  segfp = nullptr;
+
+  current.frame = trace ? trace->frame() : -1;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  if (flag) errflag = 1;
+  if (errflag) return;
+  queue.push_back(current);
+  staged += current.nbytes;
+  cond.notify_all();
+  cond.wait(lock,[this] { return staged <= limit || errflag; });
+}
+
+/* ----------------------------------------------------------------------
+   wait until all queued segments are drained or draining failed
+------------------------------------------------------------------------- */
+
+void ExtxyzStage::finish()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock,[this] { return queue.empty() || errflag; });
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ExtxyzStage::failed()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return errflag;
+}
+
+/* ----------------------------------------------------------------------
+   record drains in trace from now on, nullptr to stop
+   waits until the queued segments are drained
+------------------------------------------------------------------------- */
+
+void ExtxyzStage::set_trace(ExtxyzTrace *ptr)
+{
+  finish();
+  std::lock_guard<std::mutex> lock(mutex);
+  trace = ptr;
+}
+
+/* ----------------------------------------------------------------------
+   drain segments in the order they were queued, stop at the 1st error
+------------------------------------------------------------------------- */
+
+void ExtxyzStage::loop()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cond.wait(lock,[this] { return (!queue.empty() && !errflag) || quit; });
+    if (queue.empty() || errflag) return;
+
+    Segment segment = queue.front();
+    ExtxyzTrace *ptrace = trace;
+    lock.unlock();
+    double start = ptrace ? ptrace->now() : 0.0;
+    int flag = drain(segment);
+    if (ptrace) ptrace->add("drain",start,ptrace->now(),segment.frame);
+    lock.lock();
+
+    queue.pop_front();
+    staged -= segment.nbytes;
+    if (flag) errflag = 1;
+    cond.notify_all();
+  }
+}
+
+/* ----------------------------------------------------------------------
+   append one segment to the final file and remove it
+   return 1 if it could not be copied, the segment is then kept
+------------------------------------------------------------------------- */
+
+int ExtxyzStage::drain(const Segment &segment)
+{
+  FILE *in = fopen(segment.name.c_str(),"rb");
+  if (!in) return 1;
+
+  std::vector<char> chunk(CHUNK);
+  int flag = 0;
+  size_t n;
+  while ((n = fread(chunk.data(),sizeof(char),CHUNK,in)) > 0)
+    if (fwrite(chunk.data(),sizeof(char),n,fp) != n) flag = 1;
+  if (ferror(in)) flag = 1;
+  fclose(in);
+
+  if (fflush(fp)) flag = 1;
+  if (!flag) platform::unlink(segment.name);
+  return flag;
+}
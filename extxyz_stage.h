@@ -0,0 +1,81 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_STAGE_H
+#define LMP_EXTXYZ_STAGE_H
+
+#include "lmptype.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   burst-buffer staging of a dump file: each frame is written to its own
+   segment file in a node-local directory, a background thread appends
+   completed segments in order to the final file and deletes them
+   submit() blocks while more than limit bytes are staged, finish() and
+   the destructor drain all segments
+   after a failed write or drain no further segment is appended, the
+   failed and later segments stay in the staging directory
+------------------------------------------------------------------------- */
+
+class ExtxyzStage {
+ public:
+  ExtxyzStage(FILE *, bigint, const std::string &, const std::string &, bigint);
+  ~ExtxyzStage();
+
+  void append(const char *, size_t);
+  void submit();
+  void finish();
+  bigint tell() const { return offset; }
+  int failed();
+  void set_trace(class ExtxyzTrace *);
+
+ private:
+  struct Segment {
+    std::string name;
+    bigint nbytes;
+    bigint frame;                // trace frame of the segment
+  };
+
+  FILE *fp;                      // final file
+  std::string prefix;            // path of segments without sequence number
+  bigint limit;                  // max bytes in staged segments
+  bigint offset;                 // final file offset after appended bytes
+
+  FILE *segfp;                   // segment of current frame
+  Segment current;
+  bigint nsegment;               // # of segments created
+
+  std::deque<Segment> queue;     // completed segments not yet drained
+  bigint staged;                 // bytes in queue
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool quit;
+  int errflag;                   // 1 if a segment could not be written or drained
+  class ExtxyzTrace *trace;      // timeline of drains, nullptr if none
+
+  void loop();
+  int drain(const Segment &);
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
@@ -0,0 +1,157 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#include "extxyz_trace.h"
+
+#include "comm.h"
+#include "error.h"
+#include "platform.h"
+
+using namespace LAMMPS_NS;
+
+/* ----------------------------------------------------------------------
+   all procs start their clocks together, so events of different procs
+   line up to within the skew of the barrier
+------------------------------------------------------------------------- */
+
+ExtxyzTrace::ExtxyzTrace(LAMMPS *lmp, const char *file) : Pointers(lmp), nframe(0)
+{
+  filename = utils::strdup(file);
+  threads[std::this_thread::get_id()] = 0;
+
+  MPI_Barrier(world);
+  origin = last = platform::walltime();
+}
+
+/* ---------------------------------------------------------------------- */
+
+ExtxyzTrace::~ExtxyzTrace()
+{
+  delete[] filename;
+}
+
+/* ----------------------------------------------------------------------
+   start the next frame, events of the main thread belong to it from now
+------------------------------------------------------------------------- */
+
+void ExtxyzTrace::begin_frame(bigint ntimestep)
+{
+  nframe++;
+  steps.push_back(ntimestep);
+  last = now();
+}
+
+/* ---------------------------------------------------------------------- */
+
+double ExtxyzTrace::now() const
+{
+  return platform::walltime();
+}
+
+/* ----------------------------------------------------------------------
+   record event of the calling thread from start to end in frame iframe
+------------------------------------------------------------------------- */
+
+void ExtxyzTrace::add(const char *name, double start, double end, bigint iframe)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto result = threads.insert({std::this_thread::get_id(),(int) threads.size()});
+  events.push_back({name,start,end,result.first->second,iframe});
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzTrace::add(const char *name, double start)
+{
+  last = now();
+  add(name,start,last,frame());
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzTrace::gap(const char *name)
+{
+  double start = last;
+  last = now();
+  add(name,start,last,frame());
+}
+
+/* ----------------------------------------------------------------------
+   gather the events of all procs and write the trace file on proc 0
+   called by all procs once no thread adds events any more
+------------------------------------------------------------------------- */
+
+void ExtxyzTrace::write()
+{
+  int me = comm->me;
+  int nprocs = comm->nprocs;
+
+  std::string text = fmt::format("{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},"
+                                 "\"args\":{{\"name\":\"rank {}\"}}}}",me,me);
+  for (int tid = 0; tid < (int) threads.size(); tid++)
+    text += fmt::format(",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},"
+                        "\"args\":{{\"name\":\"{}\"}}}}",me,tid,
+                        tid ? fmt::format("thread {}",tid) : "main");
+  for (auto &event : events)
+    text += fmt::format(",\n{{\"name\":\"{}\",\"cat\":\"dump\",\"ph\":\"X\",\"pid\":{},"
+                        "\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},"
+                        "\"args\":{{\"frame\":{},\"step\":{}}}}}",
+                        event.name,me,event.tid,1.0e6*(event.start-origin),
+                        1.0e6*(event.end-event.start),event.frame,
+                        event.frame >= 0 ? steps[event.frame] : -1);
+
+  bigint nbytes = text.size();
+  bigint total = 0;
+  MPI_Reduce(&nbytes,&total,1,MPI_LMP_BIGINT,MPI_SUM,0,world);
+  int flag = (me == 0 && total > MAXSMALLINT);
+  MPI_Bcast(&flag,1,MPI_INT,0,world);
+  if (flag) {
+    if (me == 0) error->warning(FLERR,"Dump extxyz trace {} is too large to write",filename);
+    return;
+  }
+
+  int n = nbytes;
+  std::vector<int> counts(nprocs), displs(nprocs);
+  MPI_Gather(&n,1,MPI_INT,counts.data(),1,MPI_INT,0,world);
+  if (me == 0)
+    for (int iproc = 1; iproc < nprocs; iproc++) displs[iproc] = displs[iproc-1] + counts[iproc-1];
+
+  std::vector<char> all(me == 0 ? total : 0);
+  MPI_Gatherv(text.data(),n,MPI_CHAR,all.data(),counts.data(),displs.data(),MPI_CHAR,0,world);
+
+  if (me != 0) return;
+
+  FILE *fp = fopen(filename,"w");
+  if (fp == nullptr) {
+    error->warning(FLERR,"Cannot open dump extxyz trace file {}: {}",filename,
+                   utils::getsyserror());
+    return;
+  }
+  fputs("{\"traceEvents\":[\n",fp);
+  for (int iproc = 0; iproc < nprocs; iproc++) {
+    if (iproc) fputs(",\n",fp);
+    fwrite(&all[displs[iproc]],sizeof(char),counts[iproc],fp);
+  }
+  fputs("\n],\"displayTimeUnit\":\"ms\"}\n",fp);
+  fclose(fp);
+
+  utils::logmesg(lmp,"Dump extxyz trace of {} frames written to {}\n",nframe,filename);
+}
+
+/* ---------------------------------------------------------------------- */
+
+double ExtxyzTrace::memory_usage()
+{
+  return (double) events.capacity() * sizeof(Event) + (double) steps.capacity() * sizeof(bigint);
+}
@@ -0,0 +1,76 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_TRACE_H
+#define LMP_EXTXYZ_TRACE_H
+
+#include "pointers.h"
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   timeline of the phases of a dump extxyz, written as Chrome trace JSON
+   (chrome://tracing, ui.perfetto.dev) when the trace is deleted:
+     {"traceEvents":[{"name":"pack","cat":"dump","ph":"X","pid":P,"tid":T,
+       "ts":t,"dur":d,"args":{"frame":F,"step":S}},...]}
+   pid = rank, tid = thread of the rank in order of its 1st event (0 = the
+   thread that created the trace), ts and dur in microseconds since the
+   barrier in the constructor, F = # of the frame counted from 0
+   events are recorded locally, in any thread, and gathered once to proc 0
+------------------------------------------------------------------------- */
+
+class ExtxyzTrace : protected Pointers {
+ public:
+  ExtxyzTrace(class LAMMPS *, const char *);
+  ~ExtxyzTrace() override;
+
+  void begin_frame(bigint);
+  bigint frame() const { return nframe - 1; }
+  double now() const;
+  void add(const char *, double, double, bigint);
+
+  // main thread only: event from start until now, and event filling
+  // the gap since the end of the previous one of these two
+
+  void add(const char *, double);
+  void gap(const char *);
+  void write();
+  double memory_usage();
+
+ private:
+  char *filename;
+  double origin;                 // wall time of ts = 0
+  double last;                   // end of previous event of the main thread
+  bigint nframe;                 // # of frames begun
+  std::vector<bigint> steps;     // timestep of each frame
+
+  struct Event {
+    const char *name;            // string literal
+    double start, end;
+    int tid;
+    bigint frame;
+  };
+
+  std::vector<Event> events;
+  std::map<std::thread::id, int> threads;
+  std::mutex mutex;
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
@@ -0,0 +1,133 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#include "extxyz_writer.h"
+
+#include "extxyz_trace.h"
+
+using namespace LAMMPS_NS;
+
+/* ----------------------------------------------------------------------
+   start thread writing to fp, which is at file offset start
+------------------------------------------------------------------------- */
+
+ExtxyzWriter::ExtxyzWriter(FILE *ptr, bigint start) :
+  fp(ptr), offset(start), busy(false), quit(false), errflag(0), trace(nullptr), frame(-1)
+{
+  thread = std::thread(&ExtxyzWriter::loop,this);
+}
+
+/* ----------------------------------------------------------------------
+   write what is staged and stop the thread, fp stays open
+------------------------------------------------------------------------- */
+
+ExtxyzWriter::~ExtxyzWriter()
+{
+  submit();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cond.notify_all();
+  thread.join();
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzWriter::append(const char *str, size_t n)
+{
+  staging.insert(staging.end(),str,str+n);
+}
+
+/* ----------------------------------------------------------------------
+   hand the staged frame to the thread, wait only for the previous one
+------------------------------------------------------------------------- */
+
+void ExtxyzWriter::submit()
+{
+  if (staging.empty()) return;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock,[this] { return !busy; });
+  offset += staging.size();
+  pending.swap(staging);
+  staging.clear();
+  if (trace) frame = trace->frame();
+  busy = true;
+  lock.unlock();
+  cond.notify_all();
+}
+
+/* ----------------------------------------------------------------------
+   wait until all submitted frames are in the file
+------------------------------------------------------------------------- */
+
+void ExtxyzWriter::drain()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock,[this] { return !busy; });
+}
+
+/* ----------------------------------------------------------------------
+   record writes in trace from now on, nullptr to stop
+   waits for the frame in flight, which may still use the previous trace
+------------------------------------------------------------------------- */
+
+void ExtxyzWriter::set_trace(ExtxyzTrace *ptr)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock,[this] { return !busy; });
+  trace = ptr;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ExtxyzWriter::failed()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return errflag;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ExtxyzWriter::loop()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cond.wait(lock,[this] { return busy || quit; });
+    if (!busy) return;
+
+    // pending is owned by this thread until busy is cleared
+
+    ExtxyzTrace *ptrace = trace;
+    bigint iframe = frame;
+    lock.unlock();
+    double start = ptrace ? ptrace->now() : 0.0;
+    size_t n = fwrite(pending.data(),sizeof(char),pending.size(),fp);
+    int flag = (n != pending.size()) || fflush(fp);
+    if (ptrace) ptrace->add("write",start,ptrace->now(),iframe);
+    lock.lock();
+
+    if (flag) errflag = 1;
+    busy = false;
+    cond.notify_all();
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+double ExtxyzWriter::memory_usage() const
+{
+  return (double) staging.capacity() + (double) pending.capacity();
+}
@@ -0,0 +1,67 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifndef LMP_EXTXYZ_WRITER_H
+#define LMP_EXTXYZ_WRITER_H
+
+#include "lmptype.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   background thread writing the frames of a dump file
+   the dump fills the staging buffer with one frame, submit() hands it to
+   the thread and returns as soon as the previous frame has been written,
+   so at most one frame is in flight while the simulation continues
+------------------------------------------------------------------------- */
+
+class ExtxyzWriter {
+ public:
+  ExtxyzWriter(FILE *, bigint);
+  ~ExtxyzWriter();
+
+  void append(const char *, size_t);
+  void submit();
+  void drain();
+  bigint tell() const { return offset + staging.size(); }
+  int failed();
+  void set_trace(class ExtxyzTrace *);
+  double memory_usage() const;
+
+ private:
+  FILE *fp;
+  bigint offset;                 // file offset at end of submitted frames
+  std::vector<char> staging;     // frame being filled by the dump
+  std::vector<char> pending;     // frame being written by the thread
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool busy, quit;
+  int errflag;                   // 1 if a write failed, guarded by mutex
+
+  class ExtxyzTrace *trace;      // timeline of writes, nullptr if none
+  bigint frame;                  // trace frame of the staged frame
+
+  void loop();
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
@@ -0,0 +1,411 @@
+// clang-format off
+/* ----------------------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#include "reader_extxyz.h"
+
+#include "atom.h"
+#include "error.h"
+#include "platform.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using namespace LAMMPS_NS;
+
+#define MAXLINE 1024
+#define MAXCOLUMN 64
+
+// also in read_dump.cpp
+
+enum{ID,TYPE,X,Y,Z,VX,VY,VZ,Q,IX,IY,IZ,FX,FY,FZ};
+
+/* ---------------------------------------------------------------------- */
+
+ReaderEXTXYZ::ReaderEXTXYZ(LAMMPS *lmp) : Reader(lmp)
+{
+  natoms = 0;
+  nstep = 0;
+  nid = 0;
+  iframe = 0;
+
+  ncolumn = 4;
+  speciescol = 0;
+  poscol = 1;
+  velcol = forcecol = idcol = -1;
+}
+
+/* ----------------------------------------------------------------------
+   keywords after format extxyz in read_dump or rerun:
+     index FILE = frame index sidecar written by dump_modify index
+     element E1 ... EN = species name of each atom type, as in dump_modify
+------------------------------------------------------------------------- */
+
+void ReaderEXTXYZ::settings(int narg, char **arg)
+{
+  int iarg = 0;
+  while (iarg < narg) {
+    if (strcmp(arg[iarg],"index") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal read_dump extxyz command");
+      indexfile = arg[iarg+1];
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"element") == 0) {
+      int ntypes = atom->ntypes;
+      if (iarg+1+ntypes > narg) error->all(FLERR,"Illegal read_dump extxyz command");
+      elements.assign(1,std::string());
+      for (int itype = 1; itype <= ntypes; itype++) elements.emplace_back(arg[iarg+itype]);
+      iarg += 1+ntypes;
+    } else error->all(FLERR,"Illegal read_dump extxyz keyword: {}",arg[iarg]);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   frames are counted per file, the index must describe this file
+------------------------------------------------------------------------- */
+
+void ReaderEXTXYZ::open_file(const std::string &file)
+{
+  Reader::open_file(file);
+  nstep = 0;
+  iframe = 0;
+
+  if (indexfile.empty()) return;
+  if (compressed)
+    error->one(FLERR,"Read_dump extxyz index needs an uncompressed dump file: {}",file);
+  read_index();
+}
+
+/* ----------------------------------------------------------------------
+   read step and offset of every written frame from the index sidecar
+------------------------------------------------------------------------- */
+
+void ReaderEXTXYZ::read_index()
+{
+  FILE *ifp = fopen(indexfile.c_str(),"r");
+  if (ifp == nullptr)
+    error->one(FLERR,"Cannot open dump extxyz index file {}: {}",indexfile,utils::getsyserror());
+
+  frames.clear();
+  std::string entry;
+  while (read_line(ifp,entry)) {
+    if (entry.find("\"skipped\"") != std::string::npos) continue;
+    size_t step = entry.find("\"step\":");
+    size_t offset = entry.find("\"offset\":");
+    if (step == std::string::npos || offset == std::string::npos)
+      error->one(FLERR,"Invalid dump extxyz index line: {}",entry);
+    IndexFrame frame;
+    frame.step = strtoll(entry.c_str() + step + 7,nullptr,10);
+    frame.offset = strtoll(entry.c_str() + offset + 9,nullptr,10);
+    frames.push_back(frame);
+  }
+  fclose(ifp);
+}
+
+/* ----------------------------------------------------------------------
+   read atom count and comment line of the next frame
+   return 1 if there is no further frame
+------------------------------------------------------------------------- */
+
+int ReaderEXTXYZ::read_time(bigint &ntimestep)
+{
+  if (!indexfile.empty()) {
+    if (iframe >= frames.size()) return 1;
+    if (platform::fseek(fp,frames[iframe].offset) != 0)
+      error->one(FLERR,"Cannot seek to frame at step {} of extxyz dump file",frames[iframe].step);
+  }
+
+  std::string count;
+  if (!read_line(fp,count)) return 1;
+  natoms = utils::bnumeric(FLERR,utils::trim(count),false,lmp);
+  if (natoms < 0) error->one(FLERR,"Dump file is incorrectly formatted");
+  if (!read_line(fp,comment)) error->one(FLERR,"Unexpected end of dump file");
+
+  if (!indexfile.empty()) ntimestep = frames[iframe++].step;
+  else {
+    ntimestep = nstep;
+    size_t pos = comment.find("Timestep=");
+    if (pos != std::string::npos) ntimestep = strtoll(comment.c_str() + pos + 9,nullptr,10);
+  }
+  nstep++;
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   skip atom lines of the frame, with an index the next read_time() seeks
+------------------------------------------------------------------------- */
+
+void ReaderEXTXYZ::skip()
+{
+  if (!indexfile.empty()) return;
+
+  char buf[MAXLINE];
+  for (bigint i = 0; i < natoms; i++) {
+    char *eof;
+    do {
+      eof = fgets(buf,MAXLINE,fp);
+    } while (eof && !strchr(buf,'\n'));
+    if (eof == nullptr) error->one(FLERR,"Unexpected end of dump file");
+  }
+}
+
+/* ----------------------------------------------------------------------
+   box from Lattice="ax ay az bx by bz cx cy cz", which must be a LAMMPS
+   cell: a along x, b in the xy plane; columns from Properties=
+   box is returned as bounds and tilts, as a dump file stores it
+   only called by proc 0
+------------------------------------------------------------------------- */
+
+bigint ReaderEXTXYZ::read_header(double box[3][3], int &boxinfo, int &triclinic, int fieldinfo,
+                                 int nfield, int *fieldtype, char ** /*fieldlabel*/,
+                                 int scaleflag, int wrapflag, int &fieldflag,
+                                 int &xflag, int &yflag, int &zflag)
+{
+  nid = 0;
+
+  boxinfo = 0;
+  size_t pos = comment.find("Lattice=\"");
+  if (pos != std::string::npos) {
+    double lattice[9];
+    const char *ptr = comment.c_str() + pos + 9;
+    for (int k = 0; k < 9; k++) {
+      char *end;
+      lattice[k] = strtod(ptr,&end);
+      if (end == ptr) error->one(FLERR,"Invalid Lattice in extxyz dump file: {}",comment);
+      ptr = end;
+    }
+    if (lattice[1] != 0.0 || lattice[2] != 0.0 || lattice[5] != 0.0)
+      error->one(FLERR,"Lattice of extxyz dump file is not a LAMMPS cell: {}",comment);
+
+    double xy = lattice[3];
+    double xz = lattice[6];
+    double yz = lattice[7];
+    triclinic = (xy != 0.0 || xz != 0.0 || yz != 0.0) ? 1 : 0;
+    boxinfo = 1;
+
+    box[0][0] = MIN(MIN(0.0,xy),MIN(xz,xy+xz));
+    box[0][1] = lattice[0] + MAX(MAX(0.0,xy),MAX(xz,xy+xz));
+    box[1][0] = MIN(0.0,yz);
+    box[1][1] = lattice[4] + MAX(0.0,yz);
+    box[2][0] = 0.0;
+    box[2][1] = lattice[8];
+    box[0][2] = xy;
+    box[1][2] = xz;
+    box[2][2] = yz;
+  }
+
+  if (!fieldinfo) return natoms;
+
+  parse_properties();
+
+  // extxyz does not tell the style of coordinates, caller sets it
+
+  xflag = 2*scaleflag + wrapflag + 1;
+  yflag = 2*scaleflag + wrapflag + 1;
+  zflag = 2*scaleflag + wrapflag + 1;
+
+  // column of each requested field, -1 for ID = line number in frame
+
+  fieldflag = 0;
+  fieldcol.assign(nfield,-1);
+  for (int i = 0; i < nfield; i++) {
+    int col = -2;
+    switch (fieldtype[i]) {
+    case ID:
+      col = idcol;
+      break;
+    case TYPE:
+      if (speciescol >= 0) col = speciescol;
+      break;
+    case X: case Y: case Z:
+      if (poscol >= 0) col = poscol + fieldtype[i] - X;
+      break;
+    case VX: case VY: case VZ:
+      if (velcol >= 0) col = velcol + fieldtype[i] - VX;
+      break;
+    case FX: case FY: case FZ:
+      if (forcecol >= 0) col = forcecol + fieldtype[i] - FX;
+      break;
+    }
+    if (col == -2) fieldflag = 1;
+    else fieldcol[i] = col;
+  }
+
+  return natoms;
+}
+
+/* ----------------------------------------------------------------------
+   columns of the properties of an atom line from Properties=name:T:n:...
+   without it, the plain xyz layout species pos
+------------------------------------------------------------------------- */
+
+void ReaderEXTXYZ::parse_properties()
+{
+  ncolumn = 4;
+  speciescol = 0;
+  poscol = 1;
+  velcol = forcecol = idcol = -1;
+
+  size_t pos = comment.find("Properties=");
+  if (pos == std::string::npos) return;
+
+  size_t end = pos + 11;
+  while (end < comment.size() && !isspace(comment[end])) end++;
+  std::vector<std::string> words;
+  std::string spec = comment.substr(pos + 11,end - pos - 11);
+  size_t start = 0;
+  while (start <= spec.size()) {
+    size_t colon = spec.find(':',start);
+    if (colon == std::string::npos) colon = spec.size();
+    words.push_back(spec.substr(start,colon-start));
+    start = colon + 1;
+  }
+  if (words.size() % 3)
+    error->one(FLERR,"Invalid Properties in extxyz dump file: {}",comment);
+
+  ncolumn = 0;
+  speciescol = poscol = -1;
+  for (size_t i = 0; i < words.size(); i += 3) {
+    const std::string &name = words[i];
+    int count = atoi(words[i+2].c_str());
+    if (count < 1) error->one(FLERR,"Invalid Properties in extxyz dump file: {}",comment);
+    if (name == "species" && count == 1) speciescol = ncolumn;
+    else if (name == "pos" && count == 3) poscol = ncolumn;
+    else if ((name == "vel" || name == "velo") && count == 3) velcol = ncolumn;
+    else if (name == "forces" && count == 3) forcecol = ncolumn;
+    else if (name == "id" && count == 1) idcol = ncolumn;
+    ncolumn += count;
+  }
+  if (ncolumn > MAXCOLUMN)
+    error->one(FLERR,"Too many columns in extxyz dump file: {}",ncolumn);
+}
+
+/* ----------------------------------------------------------------------
+   read n atom lines, then parse them concurrently into fields
+   only called by proc 0
+------------------------------------------------------------------------- */
+
+void ReaderEXTXYZ::read_atoms(int n, int nfield, double **fields)
+{
+  text.clear();
+  starts.resize(n);
+  for (int i = 0; i < n; i++) {
+    starts[i] = text.size();
+    if (!append_line()) error->one(FLERR,"Unexpected end of dump file");
+  }
+
+  int nbad = 0;
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:nbad) schedule(static)
+#endif
+  for (int i = 0; i < n; i++)
+    nbad += parse_atom(&text[starts[i]],nid+i,nfield,fields[i]);
+
+  if (nbad)
+    for (int i = 0; i < n; i++)
+      if (parse_atom(&text[starts[i]],nid+i,nfield,fields[i]))
+        error->one(FLERR,"Invalid atom line in extxyz dump file: {}",&text[starts[i]]);
+
+  nid += n;
+}
+
+/* ----------------------------------------------------------------------
+   convert one atom line, index = position of the atom in its frame
+   return 1 if the line does not match the properties
+   called concurrently, so no error calls here
+------------------------------------------------------------------------- */
+
+int ReaderEXTXYZ::parse_atom(const char *line, bigint index, int nfield, double *values)
+{
+  const char *tokens[MAXCOLUMN];
+  int lengths[MAXCOLUMN];
+
+  const char *ptr = line;
+  for (int k = 0; k < ncolumn; k++) {
+    while (*ptr && isspace(*ptr)) ptr++;
+    if (*ptr == '\0') return 1;
+    tokens[k] = ptr;
+    while (*ptr && !isspace(*ptr)) ptr++;
+    lengths[k] = ptr - tokens[k];
+  }
+
+  for (int i = 0; i < nfield; i++) {
+    int col = fieldcol[i];
+    if (col < 0) {
+      values[i] = index + 1;
+      continue;
+    }
+
+    char *end;
+    if (col == speciescol) {
+      if (elements.empty()) {
+        values[i] = strtol(tokens[col],&end,10);
+        if (end != tokens[col] + lengths[col]) return 1;
+        continue;
+      }
+
+      int itype = 1;
+      int ntypes = elements.size() - 1;
+      for (; itype <= ntypes; itype++)
+        if ((int) elements[itype].size() == lengths[col] &&
+            strncmp(elements[itype].c_str(),tokens[col],lengths[col]) == 0) break;
+      if (itype > ntypes) return 1;
+      values[i] = itype;
+      continue;
+    }
+
+    values[i] = strtod(tokens[col],&end);
+    if (end != tokens[col] + lengths[col]) return 1;
+  }
+
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   read one line of any length from in without its line break
+   return 0 at end of file
+------------------------------------------------------------------------- */
+
+int ReaderEXTXYZ::read_line(FILE *in, std::string &str)
+{
+  char buf[MAXLINE];
+  str.clear();
+  while (fgets(buf,MAXLINE,in)) {
+    str += buf;
+    if (!str.empty() && str.back() == '\n') break;
+  }
+  if (str.empty()) return 0;
+
+  while (!str.empty() && (str.back() == '\n' || str.back() == '\r')) str.pop_back();
+  return 1;
+}
+
+/* ----------------------------------------------------------------------
+   append one line of any length to text, terminated by a null byte
+   return 0 at end of file
+------------------------------------------------------------------------- */
+
+int ReaderEXTXYZ::append_line()
+{
+  size_t start = text.size();
+  size_t length = start;
+  while (true) {
+    text.resize(length + MAXLINE);
+    if (fgets(&text[length],MAXLINE,fp) == nullptr) break;
+    length += strlen(&text[length]);
+    if (text[length-1] == '\n') break;
+  }
+  text.resize(length);
+  text.push_back('\0');
+  return (length > start) ? 1 : 0;
+}
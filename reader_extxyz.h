@@ -0,0 +1,85 @@
+/* -*- c++ -*- ----------------------------------------------------------
+   LAMMPS - Large-scale Atomic/Molecular Massively Parallel Simulator
+   https://www.lammps.org/, Sandia National Laboratories
+   Steve Plimpton, sjplimp@sandia.gov
+
+   Copyright (2003) Sandia Corporation.  Under the terms of Contract
+   DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government retains
+   certain rights in this software.  This software is distributed under
+   the GNU General Public License.
+
+   See the README file in the top-level LAMMPS directory.
+------------------------------------------------------------------------- */
+
+#ifdef READER_CLASS
+// clang-format off
+ReaderStyle(extxyz,ReaderEXTXYZ);
+// clang-format on
+#else
+
+#ifndef LMP_READER_EXTXYZ_H
+#define LMP_READER_EXTXYZ_H
+
+#include "reader.h"
+
+#include <string>
+#include <vector>
+
+namespace LAMMPS_NS {
+
+/* ----------------------------------------------------------------------
+   extxyz files as written by dump extxyz, for read_dump and rerun
+   box from the Lattice= entry, columns from Properties= (species, pos,
+   vel, forces, id), timestep from Timestep= or from the index sidecar,
+   else the frame count; with an index frames are found by seeking
+   read_dump hands one file to one reader on proc 0, so all reading is
+   done there; atom lines are parsed concurrently with OpenMP
+------------------------------------------------------------------------- */
+
+class ReaderEXTXYZ : public Reader {
+ public:
+  ReaderEXTXYZ(class LAMMPS *);
+
+  void settings(int, char **) override;
+  void open_file(const std::string &) override;
+  int read_time(bigint &) override;
+  void skip() override;
+  bigint read_header(double[3][3], int &, int &, int, int, int *, char **, int, int, int &, int &,
+                     int &, int &) override;
+  void read_atoms(int, int, double **) override;
+
+ private:
+  bigint natoms;                    // # of atoms in current frame
+  bigint nstep;                     // # of frames read so far
+  bigint nid;                       // # of atoms of current frame read so far
+  std::string comment;              // comment line of current frame
+
+  std::vector<std::string> elements;    // species name of each type, 1st unused
+  std::string indexfile;                // index sidecar, empty if none
+
+  struct IndexFrame {
+    bigint step, offset;
+  };
+  std::vector<IndexFrame> frames;   // written frames listed in the index
+  size_t iframe;                    // next frame to read from the index
+
+  // column of each property in an atom line, -1 if absent
+
+  int ncolumn;
+  int speciescol, poscol, velcol, forcecol, idcol;
+  std::vector<int> fieldcol;        // column of each requested field, -1 = sequential ID
+
+  std::vector<char> text;           // atom lines of one read_atoms() call
+  std::vector<size_t> starts;       // offset of each line in text
+
+  int read_line(FILE *, std::string &);
+  int append_line();
+  void read_index();
+  void parse_properties();
+  int parse_atom(const char *, bigint, int, double *);
+};
+
+}    // namespace LAMMPS_NS
+
+#endif
+#endif
@@ -0,0 +1,114 @@
+/* -----------------------------------------------------------------------
+   Convert the ADIOS2 output of a dump extxyz "sink adios2" to extxyz text
+
+   Syntax: adios2extxyz [-e engine] [-p digits] file.bp > file.xyz
+
+   -e = ADIOS2 engine used to read, default BP5; use SST to attach to
+        a running LAMMPS that writes with "sink adios2 NAME engine SST"
+   -p = significant digits of written values, default 17 (lossless)
+
+   each ADIOS step becomes one extxyz frame; the comment line is the
+   one the dump itself would have written
+
+   compile with e.g.
+     g++ -O2 -o adios2extxyz adios2extxyz.cpp $(adios2-config --cxx-flags --cxx-libs)
+------------------------------------------------------------------------- */
+
+#include <adios2.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+static void get_atoms(adios2::IO &io, adios2::Engine &reader, const char *name, int64_t n,
+                      std::vector<double> &data)
+{
+  data.clear();
+  auto var = io.InquireVariable<double>(name);
+  if (!var) return;
+  var.SetSelection({{0, 0}, {(size_t) n, 3}});
+  reader.Get(var, data, adios2::Mode::Sync);
+}
+
+int main(int narg, char **arg)
+{
+  std::string engine = "BP5";
+  int digits = 17;
+  const char *file = nullptr;
+
+  for (int iarg = 1; iarg < narg; iarg++) {
+    if (strcmp(arg[iarg], "-e") == 0 && iarg + 1 < narg)
+      engine = arg[++iarg];
+    else if (strcmp(arg[iarg], "-p") == 0 && iarg + 1 < narg)
+      digits = atoi(arg[++iarg]);
+    else if (!file)
+      file = arg[iarg];
+    else {
+      file = nullptr;
+      break;
+    }
+  }
+  if (!file || digits < 1) {
+    fprintf(stderr, "Syntax: adios2extxyz [-e engine] [-p digits] file\n");
+    return 1;
+  }
+
+  try {
+    adios2::ADIOS adios;
+    adios2::IO io = adios.DeclareIO("extxyz");
+    io.SetEngine(engine);
+    adios2::Engine reader = io.Open(file, adios2::Mode::Read);
+
+    std::vector<std::string> names;
+    std::vector<int> type;
+    std::vector<double> x, v, f;
+    int nframe = 0;
+
+    while (reader.BeginStep() == adios2::StepStatus::OK) {
+      if (names.empty()) {
+        auto attr = io.InquireAttribute<std::string>("species_names");
+        if (attr) names = attr.Data();
+      }
+
+      int64_t natoms = 0;
+      std::string comment;
+      reader.Get(io.InquireVariable<int64_t>("natoms"), natoms, adios2::Mode::Sync);
+      reader.Get(io.InquireVariable<std::string>("comment"), comment, adios2::Mode::Sync);
+
+      auto species = io.InquireVariable<int>("species");
+      species.SetSelection({{0}, {(size_t) natoms}});
+      reader.Get(species, type, adios2::Mode::Sync);
+      get_atoms(io, reader, "position", natoms, x);
+      get_atoms(io, reader, "velocity", natoms, v);
+      get_atoms(io, reader, "force", natoms, f);
+      reader.EndStep();
+
+      printf("%lld\n%s\n", (long long) natoms, comment.c_str());
+      for (int64_t i = 0; i < natoms; i++) {
+        int itype = type[i];
+        if (itype >= 1 && itype <= (int) names.size())
+          fputs(names[itype - 1].c_str(), stdout);
+        else
+          printf("%d", itype);
+        for (int k = 0; k < 3; k++) printf(" %.*g", digits, x[3 * i + k]);
+        if (!v.empty())
+          for (int k = 0; k < 3; k++) printf(" %.*g", digits, v[3 * i + k]);
+        if (!f.empty())
+          for (int k = 0; k < 3; k++) printf(" %.*g", digits, f[3 * i + k]);
+        putchar('\n');
+      }
+      nframe++;
+    }
+    reader.Close();
+    fprintf(stderr, "Converted %d frames\n", nframe);
+  } catch (std::exception &e) {
+    fprintf(stderr, "ERROR: %s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
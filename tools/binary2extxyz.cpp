@@ -0,0 +1,366 @@
+/* -----------------------------------------------------------------------
+   Decode the output of a dump extxyz "sink binary" to extxyz text, or
+   check it against a second binary sink of the same dump
+
+   Syntax: binary2extxyz [-p digits] file.bin > file.xyz
+           binary2extxyz -c reference.bin file.bin
+
+   -p = significant digits of written values, default 17 (lossless)
+   -c = round-trip check: decode both files and compare them frame by
+        frame, e.g. a "codec shuffle" or "codec lossy" sink against a
+        "codec none" sink with the same subsample; species must match,
+        values of kind 1 and 2 columns bit for bit, values of kind 3
+        (quantized) columns to within step/2, IDs of a dump in curve
+        order exactly; exit status 1 on a mismatch
+
+   all column kinds and both coders of the layout in extxyz_sink.h are
+   decoded; zstd coded columns need -DLAMMPS_ZSTD and libzstd
+
+   compile with e.g.
+     g++ -O2 -DLAMMPS_ZSTD -o binary2extxyz binary2extxyz.cpp -lzstd
+------------------------------------------------------------------------- */
+
+#ifdef LAMMPS_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum { ZERORLE, ZSTD };
+static constexpr int CODEC_HEADER = 2 + sizeof(int64_t);
+
+struct Column {
+  std::string name;
+  int kind;
+  double step;                  // quantization step of kind 3, else 0
+  std::vector<double> values;
+};
+
+struct Frame {
+  int64_t timestep, natoms;
+  double lattice[9];
+  std::vector<int> types;
+  std::vector<int64_t> ids;     // atom IDs, empty unless the dump is in curve order
+  std::vector<Column> columns;  // float columns in file order
+};
+
+// one binary sink file with the reference columns of the previous frame
+
+class Decoder {
+ public:
+  explicit Decoder(const char *file) : name(file)
+  {
+    fp = fopen(file, "rb");
+    if (!fp) throw std::runtime_error(std::string("cannot open ") + file);
+    char magic[8];
+    get(magic, 8);
+    if (memcmp(magic, "EXTXYZB1", 8) != 0)
+      throw std::runtime_error(name + " is not a dump extxyz binary sink file");
+    int ntypes = get_int();
+    for (int i = 0; i < ntypes; i++) {
+      int len = get_int();
+      std::string species(len, ' ');
+      get(&species[0], len);
+      names.push_back(species);
+    }
+  }
+  ~Decoder() { fclose(fp); }
+
+  std::string name;
+  std::vector<std::string> names;
+
+  // read the next frame, return false at end of file
+
+  bool next(Frame &frame)
+  {
+    if (fread(&frame.timestep, sizeof(int64_t), 1, fp) != 1) return false;
+    frame.natoms = get_int64();
+    get(frame.lattice, sizeof(frame.lattice));
+    int ncol = get_int();
+    frame.types.clear();
+    frame.ids.clear();
+    frame.columns.clear();
+
+    for (int icol = 0; icol < ncol; icol++) {
+      char label[9] = {0};
+      get(label, 8);
+      int kind = get_int();
+      int64_t nbytes = get_int64();
+      std::vector<unsigned char> data(nbytes);
+      get(data.data(), nbytes);
+
+      if (kind == 0) {
+        frame.types.resize(frame.natoms);
+        memcpy(frame.types.data(), data.data(), nbytes);
+        continue;
+      }
+      if (kind == 4) {
+        frame.ids.resize(frame.natoms);
+        memcpy(frame.ids.data(), data.data(), nbytes);
+        continue;
+      }
+
+      Column column;
+      column.name = label;
+      column.kind = kind;
+      column.step = 0.0;
+      if (kind == 1) {
+        column.values.resize(frame.natoms);
+        memcpy(column.values.data(), data.data(), nbytes);
+      } else if (kind == 2)
+        decode_shuffle(column, data, frame.natoms);
+      else if (kind == 3)
+        decode_quantized(column, data, frame.natoms);
+      else
+        throw std::runtime_error(name + ": unknown column kind " + std::to_string(kind));
+
+      // reference of the next frame is the decoded column, as in the encoder
+
+      previous[column.name] = column.values;
+      if (kind != 3) qprevious.erase(column.name);
+      frame.columns.push_back(column);
+    }
+    return true;
+  }
+
+ private:
+  FILE *fp;
+  std::map<std::string, std::vector<double>> previous;
+  std::map<std::string, std::vector<int64_t>> qprevious;
+
+  void get(void *ptr, size_t n)
+  {
+    if (fread(ptr, 1, n, fp) != n) throw std::runtime_error(name + ": truncated file");
+  }
+  int get_int()
+  {
+    int value;
+    get(&value, sizeof(int));
+    return value;
+  }
+  int64_t get_int64()
+  {
+    int64_t value;
+    get(&value, sizeof(int64_t));
+    return value;
+  }
+
+  // delta flag, coder and raw bytes of an encoded payload starting at data[pos]
+
+  std::vector<unsigned char> entropy_decode(const std::vector<unsigned char> &data, size_t pos,
+                                            int &delta)
+  {
+    if (data.size() < pos + CODEC_HEADER) throw std::runtime_error(name + ": short column");
+    delta = data[pos];
+    int coder = data[pos + 1];
+    int64_t nraw;
+    memcpy(&nraw, &data[pos + 2], sizeof(nraw));
+    const unsigned char *in = &data[pos + CODEC_HEADER];
+    size_t nin = data.size() - pos - CODEC_HEADER;
+
+    std::vector<unsigned char> raw(nraw);
+    if (coder == ZSTD) {
+#ifdef LAMMPS_ZSTD
+      size_t m = ZSTD_decompress(raw.data(), nraw, in, nin);
+      if (ZSTD_isError(m) || (int64_t) m != nraw)
+        throw std::runtime_error(name + ": corrupt zstd column");
+#else
+      throw std::runtime_error(name + ": zstd column, recompile with -DLAMMPS_ZSTD");
+#endif
+    } else if (coder == ZERORLE) {
+      size_t i = 0;
+      int64_t out = 0;
+      while (i < nin) {
+        int c = in[i++];
+        int64_t len = (c < 128) ? c + 1 : c - 127;
+        if (out + len > nraw || (c < 128 && i + len > nin))
+          throw std::runtime_error(name + ": corrupt zero-run-length column");
+        if (c < 128) {
+          memcpy(&raw[out], &in[i], len);
+          i += len;
+        } else
+          memset(&raw[out], 0, len);
+        out += len;
+      }
+      if (out != nraw) throw std::runtime_error(name + ": corrupt zero-run-length column");
+    } else
+      throw std::runtime_error(name + ": unknown coder " + std::to_string(coder));
+    return raw;
+  }
+
+  void decode_shuffle(Column &column, const std::vector<unsigned char> &data, int64_t n)
+  {
+    int delta;
+    std::vector<unsigned char> plane = entropy_decode(data, 0, delta);
+    if ((int64_t) plane.size() != n * 8) throw std::runtime_error(name + ": column size mismatch");
+    const std::vector<double> &prev = previous[column.name];
+    if (delta && (int64_t) prev.size() != n)
+      throw std::runtime_error(name + ": delta column " + column.name + " without reference");
+
+    column.values.resize(n);
+    for (int64_t i = 0; i < n; i++) {
+      uint64_t bits = 0, ref = 0;
+      for (int b = 0; b < 8; b++) bits |= (uint64_t) plane[b * n + i] << 8 * b;
+      if (delta) memcpy(&ref, &prev[i], sizeof(ref));
+      bits ^= ref;
+      memcpy(&column.values[i], &bits, sizeof(bits));
+    }
+  }
+
+  void decode_quantized(Column &column, const std::vector<unsigned char> &data, int64_t n)
+  {
+    if (data.size() < sizeof(double)) throw std::runtime_error(name + ": short column");
+    memcpy(&column.step, data.data(), sizeof(double));
+    int delta;
+    std::vector<unsigned char> varints = entropy_decode(data, sizeof(double), delta);
+    std::vector<int64_t> &qprev = qprevious[column.name];
+    if (delta && (int64_t) qprev.size() != n)
+      throw std::runtime_error(name + ": delta column " + column.name + " without reference");
+
+    std::vector<int64_t> q(n);
+    size_t pos = 0;
+    int64_t last = 0;
+    for (int64_t i = 0; i < n; i++) {
+      uint64_t z = 0;
+      int shift = 0;
+      while (true) {
+        if (pos >= varints.size() || shift > 63)
+          throw std::runtime_error(name + ": corrupt varints in " + column.name);
+        unsigned char byte = varints[pos++];
+        z |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+      }
+      int64_t r = (int64_t) (z >> 1) ^ -(int64_t) (z & 1);
+      q[i] = r + (delta ? qprev[i] : last);
+      last = q[i];
+    }
+
+    column.values.resize(n);
+    for (int64_t i = 0; i < n; i++) column.values[i] = q[i] * column.step;
+    qprev.swap(q);
+  }
+};
+
+static void print_frame(const Frame &frame, const std::vector<std::string> &names, int digits)
+{
+  const double *a = frame.lattice;
+  printf("%lld\nLattice=\"%.*g %.*g %.*g %.*g %.*g %.*g %.*g %.*g %.*g\" ",
+         (long long) frame.natoms, digits, a[0], digits, a[1], digits, a[2], digits, a[3],
+         digits, a[4], digits, a[5], digits, a[6], digits, a[7], digits, a[8]);
+  printf("Properties=species:S:1:pos:R:3");
+  if (frame.columns.size() > 3) printf(":vel:R:3");
+  if (frame.columns.size() > 6) printf(":forces:R:3");
+  if (!frame.ids.empty()) printf(":id:I:1");
+  printf(" Timestep=%lld\n", (long long) frame.timestep);
+
+  for (int64_t i = 0; i < frame.natoms; i++) {
+    int itype = frame.types[i];
+    if (itype >= 1 && itype <= (int) names.size())
+      fputs(names[itype - 1].c_str(), stdout);
+    else
+      printf("%d", itype);
+    for (auto &column : frame.columns) printf(" %.*g", digits, column.values[i]);
+    if (!frame.ids.empty()) printf(" %lld", (long long) frame.ids[i]);
+    putchar('\n');
+  }
+}
+
+// number of values of frame b that differ from reference frame a
+
+static int64_t compare_frames(const Frame &a, const Frame &b)
+{
+  if (a.timestep != b.timestep || a.natoms != b.natoms || a.types != b.types ||
+      a.ids != b.ids || a.columns.size() != b.columns.size())
+    return a.natoms > 0 ? a.natoms : 1;
+
+  int64_t nbad = 0;
+  for (size_t k = 0; k < a.columns.size(); k++) {
+    const Column &ref = a.columns[k];
+    const Column &col = b.columns[k];
+    for (int64_t i = 0; i < a.natoms; i++) {
+      double x = ref.values[i], y = col.values[i];
+      if (col.kind == 3) {
+        if (!(fabs(x - y) <= 0.5 * col.step)) nbad++;
+      } else if (memcmp(&x, &y, sizeof(double)) != 0)
+        nbad++;
+    }
+  }
+  return nbad;
+}
+
+int main(int narg, char **arg)
+{
+  int digits = 17;
+  const char *reference = nullptr;
+  const char *file = nullptr;
+
+  for (int iarg = 1; iarg < narg; iarg++) {
+    if (strcmp(arg[iarg], "-p") == 0 && iarg + 1 < narg)
+      digits = atoi(arg[++iarg]);
+    else if (strcmp(arg[iarg], "-c") == 0 && iarg + 1 < narg)
+      reference = arg[++iarg];
+    else if (!file)
+      file = arg[iarg];
+    else {
+      file = nullptr;
+      break;
+    }
+  }
+  if (!file || digits < 1) {
+    fprintf(stderr, "Syntax: binary2extxyz [-p digits] file.bin\n"
+                    "        binary2extxyz -c reference.bin file.bin\n");
+    return 1;
+  }
+
+  try {
+    Decoder decoder(file);
+    Frame frame;
+    int nframe = 0;
+
+    if (!reference) {
+      while (decoder.next(frame)) {
+        print_frame(frame, decoder.names, digits);
+        nframe++;
+      }
+      fprintf(stderr, "Converted %d frames\n", nframe);
+      return 0;
+    }
+
+    Decoder check(reference);
+    Frame expect;
+    int nbadframe = 0;
+    while (true) {
+      bool more = check.next(expect);
+      if (more != decoder.next(frame)) {
+        fprintf(stderr, "ERROR: %s and %s have different numbers of frames\n", reference, file);
+        return 1;
+      }
+      if (!more) break;
+      int64_t nbad = compare_frames(expect, frame);
+      if (nbad) {
+        fprintf(stderr, "Frame %d step %lld: %lld values differ\n", nframe,
+                (long long) expect.timestep, (long long) nbad);
+        nbadframe++;
+      }
+      nframe++;
+    }
+    if (check.names != decoder.names) {
+      fprintf(stderr, "ERROR: species tables differ\n");
+      return 1;
+    }
+    fprintf(stderr, "Checked %d frames, %d differ\n", nframe, nbadframe);
+    return nbadframe ? 1 : 0;
+  } catch (std::exception &e) {
+    fprintf(stderr, "ERROR: %s\n", e.what());
+    return 1;
+  }
+}